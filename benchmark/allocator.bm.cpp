@@ -1,23 +1,154 @@
 #include <memory>
+#include <vector>
 #include <benchmark/benchmark.h>
 
 #include <memory/allocator.h>
+#include <memory/pool.h>
 
+// allocate and release one small block, see workload.bm for whole programs
 static void STD_Allocate(benchmark::State& state) {
   for (auto _ : state){
     std::allocator<int> alloc;
-    alloc.allocate(2);
+    int *data = alloc.allocate(2);
+    benchmark::DoNotOptimize(data);
+    alloc.deallocate(data, 2);
   }
 }
 
 static void SQRL_Allocate(benchmark::State& state) {
   for (auto _ : state){
     sqrl::Allocator<int> alloc;
-    alloc.allocate(2);
+    int *data = alloc.allocate(2);
+    benchmark::DoNotOptimize(data);
+    alloc.deallocate(data, 2);
   }
 }
 
+// allocate and release one block while the heap holds state.range(0) blocks
+// of mixed sizes, the cost should stay flat as the heap grows
+static void SQRL_AllocateWithHeapSize(benchmark::State& state) {
+  sqrl::Allocator<int> alloc;
+  std::vector<int*> heap;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    heap.push_back(alloc.allocate(1 + i % 64));
+  }
+  // released blocks of other sizes are scattered all over the heap
+  for (size_t i = 0; i < heap.size(); i += 2) {
+    alloc.deallocate(heap[i], 1);
+  }
+  for (auto _ : state){
+    int *data = alloc.allocate(100);
+    benchmark::DoNotOptimize(data);
+    alloc.deallocate(data, 100);
+  }
+  for (size_t i = 1; i < heap.size(); i += 2) {
+    alloc.deallocate(heap[i], 1);
+  }
+}
+
+// bursts of small allocations from many threads at once, with thread cache
+// throughput should grow linearly with number of threads
+template <class Alloc> static void AllocateFromThreads(benchmark::State& state) {
+  Alloc alloc;
+  int *data[64];
+  for (auto _ : state){
+    for (int i = 0; i < 64; i++) {
+      data[i] = alloc.allocate(1 + i % 32);
+    }
+    for (int i = 0; i < 64; i++) {
+      alloc.deallocate(data[i], 1 + i % 32);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+
+// every thread keeps state.range(0) small blocks at once, beyond a magazine
+// each batch of them is refilled and flushed under the central heap lock
+template <class Alloc> static void RefillFromThreads(benchmark::State& state) {
+  Alloc alloc;
+  size_t number = state.range(0);
+  std::vector<int64_t *> blocks(number);
+  for (auto _ : state) {
+    for (size_t i = 0; i < number; i++) {
+      blocks[i] = alloc.allocate(8);
+    }
+    for (size_t i = 0; i < number; i++) {
+      alloc.deallocate(blocks[i], 8);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * number);
+}
+
+// allocate and release nodes of one size in a hot loop
+template <class Alloc> static void AllocateNodes(benchmark::State& state) {
+  Alloc alloc;
+  int64_t *nodes[256];
+  for (auto _ : state){
+    for (int i = 0; i < 256; i++) {
+      nodes[i] = alloc.allocate(1);
+    }
+    for (int i = 0; i < 256; i++) {
+      alloc.deallocate(nodes[i], 1);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 256);
+}
+
+// allocate, touch and release a large buffer over and over, released
+// mappings are reused instead of being mapped and faulted in again
+template <class Alloc> static void RecycleLargeBlock(benchmark::State& state) {
+  Alloc alloc;
+  size_t size = state.range(0) << 20;
+  for (auto _ : state) {
+    char *data = alloc.allocate(size);
+    for (size_t i = 0; i < size; i += 4096) {
+      data[i] = 1;
+    }
+    benchmark::DoNotOptimize(data);
+    alloc.deallocate(data, size);
+  }
+}
+
+// allocate and release one block of state.range(0) bytes, build with cmake
+// option SQRL_HARDENED to measure the cost of its checks
+static void SQRL_AllocateRelease(benchmark::State& state) {
+  sqrl::Allocator<char> alloc;
+  size_t size = state.range(0);
+  for (auto _ : state) {
+    char *data = alloc.allocate(size);
+    benchmark::DoNotOptimize(data);
+    alloc.deallocate(data, size);
+  }
+#ifdef SQRL_HARDENED
+  state.SetLabel("hardened");
+#endif
+}
+
 BENCHMARK(STD_Allocate);
 BENCHMARK(SQRL_Allocate);
+BENCHMARK(SQRL_AllocateWithHeapSize)->RangeMultiplier(4)->Range(1 << 4, 1 << 18);
+BENCHMARK_TEMPLATE(AllocateFromThreads, std::allocator<int>)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(AllocateFromThreads, sqrl::Allocator<int>)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(RefillFromThreads, std::allocator<int64_t>)
+    ->Arg(16)
+    ->Arg(1024)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(RefillFromThreads, sqrl::Allocator<int64_t>)
+    ->Arg(16)
+    ->Arg(1024)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(AllocateNodes, std::allocator<int64_t>);
+BENCHMARK_TEMPLATE(AllocateNodes, sqrl::Allocator<int64_t>);
+BENCHMARK_TEMPLATE(AllocateNodes, sqrl::PoolAllocator<int64_t>);
+
+BENCHMARK_TEMPLATE(RecycleLargeBlock, std::allocator<char>)->Arg(1)->Arg(64);
+BENCHMARK_TEMPLATE(RecycleLargeBlock, sqrl::Allocator<char>)->Arg(1)->Arg(64);
+BENCHMARK(SQRL_AllocateRelease)->RangeMultiplier(16)->Range(16, 1 << 20);
 
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCHMARK_MAIN();
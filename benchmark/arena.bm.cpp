@@ -0,0 +1,88 @@
+#include <memory>
+#include <benchmark/benchmark.h>
+
+#include <container/vector.h>
+#include <memory/arena.h>
+
+struct Node {
+  Node *left;
+  Node *right;
+  int64_t value;
+};
+
+// build a tree of state.range(0) nodes and throw it away, like one request
+template <class Alloc> static Node *BuildTree(Alloc &alloc, int64_t n) {
+  Node *root = nullptr;
+  for (int64_t i = 0; i < n; i++) {
+    Node *node = alloc.allocate(1);
+    node->left = root;
+    node->right = nullptr;
+    node->value = i;
+    root = node;
+  }
+  return root;
+}
+
+template <class Alloc> static void FreeTree(Alloc &alloc, Node *root) {
+  while (root != nullptr) {
+    Node *left = root->left;
+    alloc.deallocate(root, 1);
+    root = left;
+  }
+}
+
+static void STD_ObjectGraph(benchmark::State& state) {
+  std::allocator<Node> alloc;
+  for (auto _ : state){
+    FreeTree(alloc, BuildTree(alloc, state.range(0)));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void SQRL_ObjectGraph(benchmark::State& state) {
+  sqrl::Allocator<Node> alloc;
+  for (auto _ : state){
+    FreeTree(alloc, BuildTree(alloc, state.range(0)));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void SQRL_ObjectGraphOnArena(benchmark::State& state) {
+  sqrl::MonotonicArena arena;
+  sqrl::ArenaAllocator<Node> alloc(arena);
+  for (auto _ : state){
+    benchmark::DoNotOptimize(BuildTree(alloc, state.range(0)));
+    // no free per node, the whole graph goes at once
+    arena.reset();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void SQRL_VectorGrow(benchmark::State& state) {
+  for (auto _ : state){
+    sqrl::Vector<int64_t> v;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      v.push_back(i);
+    }
+  }
+}
+
+static void SQRL_VectorGrowOnArena(benchmark::State& state) {
+  for (auto _ : state){
+    {
+      sqrl::Vector<int64_t, sqrl::ArenaAllocator<int64_t>> v;
+      for (int64_t i = 0; i < state.range(0); i++) {
+        v.push_back(i);
+      }
+    }
+    sqrl::MonotonicArena::local().reset();
+  }
+}
+
+BENCHMARK(STD_ObjectGraph)->Range(1 << 6, 1 << 14);
+BENCHMARK(SQRL_ObjectGraph)->Range(1 << 6, 1 << 14);
+BENCHMARK(SQRL_ObjectGraphOnArena)->Range(1 << 6, 1 << 14);
+BENCHMARK(SQRL_VectorGrow)->Range(1 << 6, 1 << 14);
+BENCHMARK(SQRL_VectorGrowOnArena)->Range(1 << 6, 1 << 14);
+
+BENCHMARK_MAIN();
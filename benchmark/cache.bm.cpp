@@ -5,8 +5,10 @@
 #include <random>
 
 #include <container/vector.h>
+#include <memory/allocator.h>
 
 #define KB(x) ((size_t)x << 10)
+#define MB(x) ((size_t)x << 20)
 static void Memory_Access(benchmark::State &state) {
   auto size = state.range(0);
   std::uniform_int_distribution<> dis(0, KB(size) - 1);
@@ -39,4 +41,34 @@ BENCHMARK(Memory_Access)
     ->Arg(1 << 16)
     ->Arg(1 << 17);
 
+// random access over a large block, once by plain pages and once by huge
+// pages, cheap index so TLB misses are what it measures
+static void Large_Memory_Access(benchmark::State &state) {
+  size_t size = MB(state.range(0));
+  bool huge = state.range(1);
+  sqrl::GenericAllocator allocator;
+  set_huge_page(huge);
+  char *memory = (char *)allocator.allocate(size);
+  set_huge_page(false);
+  std::fill(memory, memory + size, 1);
+  uint64_t seed = 88172645463325252ULL;
+  int dummy = 0;
+  for (auto _ : state) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    benchmark::DoNotOptimize(dummy += memory[seed % size]);
+  }
+  state.SetLabel(huge ? "huge page" : "plain page");
+  allocator.deallocate((word_t *)memory, size);
+}
+
+BENCHMARK(Large_Memory_Access)
+    ->Args({16, 0})
+    ->Args({16, 1})
+    ->Args({256, 0})
+    ->Args({256, 1})
+    ->Args({1024, 0})
+    ->Args({1024, 1});
+
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <benchmark/benchmark.h>
+
+#include <container/mpmc_queue.h>
+
+// half of threads push one element per iteration, the other half pop one,
+// producers and consumers scale from 1 to 32 each
+
+static const size_t kQueueSize = 1024;
+
+// bounded deque under a mutex, waits like MPMCQueue does
+class MutexQueue {
+public:
+  void push(int64_t value) {
+    size_t spins = 0;
+    while (true) {
+      {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (_queue.size() < kQueueSize) {
+          _queue.push_back(value);
+          return;
+        }
+      }
+      sqrl::_queue_backoff(spins);
+    }
+  }
+  void pop(int64_t &out) {
+    size_t spins = 0;
+    while (true) {
+      {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (!_queue.empty()) {
+          out = _queue.front();
+          _queue.pop_front();
+          return;
+        }
+      }
+      sqrl::_queue_backoff(spins);
+    }
+  }
+
+private:
+  std::mutex _mutex;
+  std::deque<int64_t> _queue;
+};
+
+// queues of every thread count are drained, pushes and pops are as many
+template <class Q> static void Contention(benchmark::State& state) {
+  static Q queue;
+  bool producer = state.thread_index() % 2 == 0;
+  int64_t value = 0;
+  for (auto _ : state) {
+    if (producer) {
+      queue.push(value++);
+    } else {
+      queue.pop(value);
+    }
+  }
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations());
+}
+
+class SQRL_MPMCQueue : public sqrl::MPMCQueue<int64_t> {
+public:
+  SQRL_MPMCQueue() : sqrl::MPMCQueue<int64_t>(kQueueSize) {}
+};
+
+BENCHMARK_TEMPLATE(Contention, MutexQueue)->ThreadRange(2, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(Contention, SQRL_MPMCQueue)
+    ->ThreadRange(2, 64)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
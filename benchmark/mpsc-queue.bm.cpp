@@ -0,0 +1,48 @@
+#include <memory>
+#include <thread>
+#include <benchmark/benchmark.h>
+
+#include <container/mpsc_queue.h>
+#include <container/safe_queue.h>
+
+// thread 0 dispatches by batches of 64 while the others submit one element
+// per iteration, submitters scale from 1 to 31. Every thread leaves its loop
+// together, the dispatcher takes what is left afterwards.
+
+static const size_t kBatch = 64;
+
+template <class Q> static void Submit(benchmark::State& state) {
+  static Q inbox;
+  int64_t batch[kBatch];
+  int64_t value = 0;
+  size_t spins = 0;
+  for (auto _ : state) {
+    if (state.thread_index() != 0) {
+      inbox.push(value++);
+    } else if (inbox.drain(batch, kBatch) == 0) {
+      sqrl::_queue_backoff(spins);
+    } else {
+      spins = 0;
+    }
+  }
+  if (state.thread_index() == 0) {
+    while (inbox.drain(batch, kBatch) != 0) {
+    }
+  } else {
+    state.SetItemsProcessed(state.iterations());
+  }
+}
+
+BENCHMARK_TEMPLATE(Submit, sqrl::SafeQueue<int64_t>)
+    ->ThreadRange(2, 32)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(Submit, sqrl::Inbox<int64_t>)
+    ->ThreadRange(2, 32)
+    ->UseRealTime();
+
+// nodes from malloc, how much the node allocator costs
+BENCHMARK_TEMPLATE(Submit, sqrl::Inbox<int64_t, std::allocator<int64_t>>)
+    ->ThreadRange(2, 32)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,99 @@
+#include <deque>
+#include <benchmark/benchmark.h>
+
+#include <container/queue.h>
+
+// push state.range(0) elements then pop all of them, queues grow as needed
+
+static void STD_DequeBurst(benchmark::State& state) {
+  for (auto _ : state){
+    std::deque<int64_t> q;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      q.push_back(i);
+    }
+    while (!q.empty()) {
+      benchmark::DoNotOptimize(q.front());
+      q.pop_front();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void SQRL_QueueBurst(benchmark::State& state) {
+  for (auto _ : state){
+    sqrl::Queue<int64_t> q;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      q.push(i);
+    }
+    while (!q.empty()) {
+      benchmark::DoNotOptimize(q.front());
+      q.pop();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// keep state.range(0) elements queued, push one and pop one
+
+static void STD_DequeSteady(benchmark::State& state) {
+  std::deque<int64_t> q(state.range(0), 0);
+  int64_t i = 0;
+  for (auto _ : state){
+    q.push_back(i++);
+    benchmark::DoNotOptimize(q.front());
+    q.pop_front();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void SQRL_QueueSteady(benchmark::State& state) {
+  sqrl::Queue<int64_t> q;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    q.push(0);
+  }
+  int64_t i = 0;
+  for (auto _ : state){
+    q.push(i++);
+    benchmark::DoNotOptimize(q.front());
+    q.pop();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// move elements in and out by batches of state.range(0)
+
+static void STD_DequeBatch(benchmark::State& state) {
+  std::deque<int64_t> q;
+  std::deque<int64_t> batch(state.range(0), 1);
+  std::deque<int64_t> out(state.range(0));
+  for (auto _ : state){
+    q.insert(q.end(), batch.begin(), batch.end());
+    std::copy(q.begin(), q.begin() + state.range(0), out.begin());
+    q.erase(q.begin(), q.begin() + state.range(0));
+    benchmark::DoNotOptimize(out.front());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void SQRL_QueueBatch(benchmark::State& state) {
+  sqrl::Queue<int64_t> q;
+  int64_t *batch = new int64_t[state.range(0)]();
+  int64_t *out = new int64_t[state.range(0)];
+  for (auto _ : state){
+    q.push_n(batch, state.range(0));
+    q.pop_n(out, state.range(0));
+    benchmark::DoNotOptimize(out[0]);
+  }
+  delete[] batch;
+  delete[] out;
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(STD_DequeBurst)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(SQRL_QueueBurst)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(STD_DequeSteady)->Arg(64)->Arg(1 << 16);
+BENCHMARK(SQRL_QueueSteady)->Arg(64)->Arg(1 << 16);
+BENCHMARK(STD_DequeBatch)->Arg(16)->Arg(1024);
+BENCHMARK(SQRL_QueueBatch)->Arg(16)->Arg(1024);
+
+BENCHMARK_MAIN();
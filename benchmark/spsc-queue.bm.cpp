@@ -0,0 +1,79 @@
+#include <thread>
+#include <benchmark/benchmark.h>
+
+#include <container/safe_queue.h>
+#include <container/spsc_queue.h>
+
+// thread 0 pushes and thread 1 pops state.range(0) elements per iteration,
+// one by one or by batches of 64
+
+static const size_t kQueueSize = 1024;
+static const size_t kBatch = 64;
+
+// SafeQueue takes its lock once per element, or once per batch by push_n
+// and drain, it never runs out of room
+class SQRL_SafeQueue : public sqrl::SafeQueue<int64_t> {
+public:
+  SQRL_SafeQueue() : sqrl::SafeQueue<int64_t>(kQueueSize) {}
+  bool try_push(int64_t value) { return push(value); }
+  size_t push_n(const int64_t *items, size_t n) {
+    sqrl::SafeQueue<int64_t>::push_n(items, n);
+    return n;
+  }
+  size_t pop_n(int64_t *out, size_t n) { return drain(out, n); }
+};
+
+class SQRL_SPSCQueue : public sqrl::SPSCQueue<int64_t> {
+public:
+  SQRL_SPSCQueue() : sqrl::SPSCQueue<int64_t>(kQueueSize) {}
+};
+
+template <class Q> static void PushPop(benchmark::State& state) {
+  static Q queue;
+  int64_t value = 0;
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); i++) {
+      size_t spins = 0;
+      if (state.thread_index() == 0) {
+        while (!queue.try_push(i)) {
+          sqrl::_queue_backoff(spins);
+        }
+      } else {
+        while (!queue.try_pop(value)) {
+          sqrl::_queue_backoff(spins);
+        }
+      }
+    }
+  }
+  benchmark::DoNotOptimize(value);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Q> static void PushPopBatch(benchmark::State& state) {
+  static Q queue;
+  int64_t batch[kBatch] = {};
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); i += kBatch) {
+      size_t done = 0;
+      size_t spins = 0;
+      while (done < kBatch) {
+        size_t n = state.thread_index() == 0
+                       ? queue.push_n(batch + done, kBatch - done)
+                       : queue.pop_n(batch + done, kBatch - done);
+        if (n == 0) {
+          sqrl::_queue_backoff(spins);
+        }
+        done += n;
+      }
+    }
+  }
+  benchmark::DoNotOptimize(batch[0]);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(PushPop, SQRL_SafeQueue)->Arg(1 << 16)->Threads(2);
+BENCHMARK_TEMPLATE(PushPop, SQRL_SPSCQueue)->Arg(1 << 16)->Threads(2);
+BENCHMARK_TEMPLATE(PushPopBatch, SQRL_SafeQueue)->Arg(1 << 16)->Threads(2);
+BENCHMARK_TEMPLATE(PushPopBatch, SQRL_SPSCQueue)->Arg(1 << 16)->Threads(2);
+
+BENCHMARK_MAIN();
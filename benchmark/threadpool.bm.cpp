@@ -0,0 +1,80 @@
+#include <functional>
+#include <numeric>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include <thread/threadpool.h>
+
+// the pool is started once per run with range(0) workers, the caller
+// awaits the root task so it helps as well
+
+static int Fib(sqrl::ThreadPool& tp, int n) {
+  if (n < 15) {
+    // small enough to be run inline
+    return n < 2 ? n : Fib(tp, n - 1) + Fib(tp, n - 2);
+  }
+  auto left = tp.enqueue(Fib, std::ref(tp), n - 1);
+  int right = Fib(tp, n - 2);
+  return tp.await(left) + right;
+}
+
+static void ForkJoinFib(benchmark::State& state) {
+  sqrl::ThreadPool tp(state.range(0));
+  tp.start();
+  for (auto _ : state) {
+    auto result = tp.enqueue(Fib, std::ref(tp), 25);
+    benchmark::DoNotOptimize(tp.await(result));
+  }
+  tp.stop();
+  state.counters["tasks"] = tp.get_handled_tasks_num();
+}
+
+static const size_t kGrain = 1 << 12;
+
+static int64_t Sum(sqrl::ThreadPool& tp, const int64_t* first, size_t n) {
+  if (n <= kGrain) {
+    return std::accumulate(first, first + n, int64_t(0));
+  }
+  auto left = tp.enqueue(Sum, std::ref(tp), first, n / 2);
+  int64_t right = Sum(tp, first + n / 2, n - n / 2);
+  return tp.await(left) + right;
+}
+
+static void ParallelSum(benchmark::State& state) {
+  std::vector<int64_t> data(1 << 22);
+  std::iota(data.begin(), data.end(), 0);
+  sqrl::ThreadPool tp(state.range(0));
+  tp.start();
+  for (auto _ : state) {
+    auto result = tp.enqueue(Sum, std::ref(tp), data.data(), data.size());
+    benchmark::DoNotOptimize(tp.await(result));
+  }
+  tp.stop();
+  state.SetBytesProcessed(state.iterations() * data.size() * sizeof(int64_t));
+}
+
+// tasks enqueued from outside the pool one by one, then awaited
+static void SmallTasks(benchmark::State& state) {
+  const int tasks = 10000;
+  std::vector<sqrl::Future<int>> results;
+  results.reserve(tasks);
+  sqrl::ThreadPool tp(state.range(0));
+  tp.start();
+  for (auto _ : state) {
+    for (int i = 0; i < tasks; i++) {
+      results.emplace_back(tp.enqueue([i]() { return i; }));
+    }
+    for (auto& result : results) {
+      benchmark::DoNotOptimize(tp.await(result));
+    }
+    results.clear();
+  }
+  tp.stop();
+  state.SetItemsProcessed(state.iterations() * tasks);
+}
+
+BENCHMARK(ForkJoinFib)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK(ParallelSum)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK(SmallTasks)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+BENCHMARK_MAIN();
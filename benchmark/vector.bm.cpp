@@ -0,0 +1,106 @@
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include <container/vector.h>
+#include <string/string.h>
+
+// push_back state.range(0) elements, the vector relocates them as it grows
+
+static void STD_VectorPushBackPOD(benchmark::State& state) {
+  for (auto _ : state){
+    std::vector<int64_t> v;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      v.push_back(i);
+    }
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Growth>
+static void SQRL_VectorPushBackPOD(benchmark::State& state) {
+  for (auto _ : state){
+    sqrl::Vector<int64_t, sqrl::Allocator<int64_t>, Growth> v;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      v.push_back(i);
+    }
+    benchmark::DoNotOptimize(v.begin());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void STD_VectorPushBackString(benchmark::State& state) {
+  for (auto _ : state){
+    std::vector<std::string> v;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      v.push_back(std::string("a string too long for inline buffer"));
+    }
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// strings are relocated by memcpy, see is_trivially_relocatable
+template <class Growth>
+static void SQRL_VectorPushBackString(benchmark::State& state) {
+  for (auto _ : state){
+    sqrl::Vector<sqrl::String, sqrl::Allocator<sqrl::String>, Growth> v;
+    for (int64_t i = 0; i < state.range(0); i++) {
+      v.push_back(sqrl::String("a string too long for inline buffer"));
+    }
+    benchmark::DoNotOptimize(v.begin());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// build a vector of state.range(0) elements out of an input buffer
+
+static void STD_VectorFromBuffer(benchmark::State& state) {
+  std::vector<int64_t> input(state.range(0), 1);
+  for (auto _ : state){
+    std::vector<int64_t> v(input.data(), input.data() + input.size());
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void SQRL_VectorFromBuffer(benchmark::State& state) {
+  std::vector<int64_t> input(state.range(0), 1);
+  for (auto _ : state){
+    sqrl::Vector<int64_t> v(input.data(), input.data() + input.size());
+    benchmark::DoNotOptimize(v.begin());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// append the buffer in chunks of 4096 elements
+static void SQRL_VectorAppendRange(benchmark::State& state) {
+  std::vector<int64_t> input(4096, 1);
+  for (auto _ : state){
+    sqrl::Vector<int64_t> v;
+    for (int64_t i = 0; i < state.range(0); i += 4096) {
+      v.append_range(input);
+    }
+    benchmark::DoNotOptimize(v.begin());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(STD_VectorPushBackPOD)->Arg(1 << 20)->Arg(1 << 23);
+BENCHMARK_TEMPLATE(SQRL_VectorPushBackPOD, sqrl::GrowthFactor<2>)
+    ->Arg(1 << 20)
+    ->Arg(1 << 23);
+BENCHMARK_TEMPLATE(SQRL_VectorPushBackPOD, sqrl::GrowthFactor<3, 2>)
+    ->Arg(1 << 20)
+    ->Arg(1 << 23);
+BENCHMARK(STD_VectorPushBackString)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(SQRL_VectorPushBackString, sqrl::GrowthFactor<2>)
+    ->Arg(1 << 20);
+BENCHMARK_TEMPLATE(SQRL_VectorPushBackString, sqrl::GrowthFactor<3, 2>)
+    ->Arg(1 << 20);
+BENCHMARK(STD_VectorFromBuffer)->Arg(1 << 20)->Arg(1 << 23);
+BENCHMARK(SQRL_VectorFromBuffer)->Arg(1 << 20)->Arg(1 << 23);
+BENCHMARK(SQRL_VectorAppendRange)->Arg(1 << 20)->Arg(1 << 23);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+
+#include <memory/allocator.h>
+#include <memory/arena.h>
+#include <memory/pool.h>
+
+/*
+Allocation workloads closer to real programs than a hot loop of one size,
+every allocator runs the same sequence of requests:
+- throughput as items per second, one item is an allocation and its release
+- rss, resident set size of the process once the workload is in full swing
+- p50/p99/p999 latency of allocate and deallocate in Latency
+*/
+
+// allocations are counted in units, a pool serves objects of one unit
+struct Unit {
+  int64_t words[2];
+};
+
+// xorshift, cheap and the same sequence on every run
+struct Random {
+  uint64_t state;
+  uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+};
+
+// half of the objects are one unit, most others are small, a few are KiBs
+static size_t random_units(Random &random) {
+  uint64_t r = random.next();
+  if (r % 2 == 0) {
+    return 1;
+  }
+  if (r % 32 != 1) {
+    return 2 + (r >> 8) % 7;
+  }
+  return 9 + (r >> 8) % 248;
+}
+
+static size_t resident_size() {
+  long pages = 0;
+  long resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+  if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(statm);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void report_rss(benchmark::State &state) {
+  state.counters["rss"] = benchmark::Counter(
+      resident_size(), benchmark::Counter::kDefaults,
+      benchmark::Counter::OneK::kIs1024);
+}
+
+// an arena gives everything back at once, others do it one by one
+template <class Alloc> static void release_all(Alloc &) {}
+template <class T> static void release_all(sqrl::ArenaAllocator<T> &alloc) {
+  alloc.arena().reset();
+}
+
+struct Entry {
+  Unit *data;
+  size_t units;
+};
+
+template <class Alloc> static Entry allocate_entry(Alloc &alloc, size_t units) {
+  Unit *data = alloc.allocate(units);
+  // touch it as a program does
+  data->words[0] = units;
+  return Entry{data, units};
+}
+
+template <class Alloc> static void deallocate_entry(Alloc &alloc, Entry &entry) {
+  if (entry.data != nullptr) {
+    alloc.deallocate(entry.data, entry.units);
+    entry.data = nullptr;
+  }
+}
+
+// a burst of mixed sizes released in random order, like one request
+template <class Alloc> static void MixedSizes(benchmark::State &state) {
+  Alloc alloc;
+  Random random{42};
+  Entry entries[256];
+  size_t units[256];
+  size_t order[256];
+  for (size_t i = 0; i < 256; i++) {
+    units[i] = random_units(random);
+    order[i] = i;
+  }
+  for (size_t i = 255; i > 0; i--) {
+    std::swap(order[i], order[random.next() % (i + 1)]);
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i < 256; i++) {
+      entries[i] = allocate_entry(alloc, units[i]);
+    }
+    for (size_t i = 0; i < 256; i++) {
+      deallocate_entry(alloc, entries[order[i]]);
+    }
+    release_all(alloc);
+  }
+  state.SetItemsProcessed(state.iterations() * 256);
+  report_rss(state);
+}
+
+/*
+Keep state.range(0) blocks alive and replace a random one at a time by one
+of another size, small and large blocks interleave and fragment the heap.
+rss_per_live is resident size over live bytes.
+*/
+template <class Alloc> static void Churn(benchmark::State &state) {
+  Alloc alloc;
+  Random random{7};
+  std::vector<Entry> live(state.range(0));
+  auto churn_units = [&random]() -> size_t {
+    uint64_t r = random.next();
+    return r % 4 == 0 ? 64 + (r >> 8) % 448 : 1 + (r >> 8) % 4;
+  };
+  size_t live_units = 0;
+  for (auto &entry : live) {
+    entry = allocate_entry(alloc, churn_units());
+    live_units += entry.units;
+  }
+  for (auto _ : state) {
+    Entry &entry = live[random.next() % live.size()];
+    live_units -= entry.units;
+    deallocate_entry(alloc, entry);
+    entry = allocate_entry(alloc, churn_units());
+    live_units += entry.units;
+  }
+  state.SetItemsProcessed(state.iterations());
+  report_rss(state);
+  state.counters["rss_per_live"] =
+      (double)resident_size() / (live_units * sizeof(Unit));
+  for (auto &entry : live) {
+    deallocate_entry(alloc, entry);
+  }
+}
+
+struct Batch {
+  Entry entries[64];
+};
+
+/*
+Threads come in pairs, one allocates batches and the other releases them,
+every block is released on another thread than the one allocating it.
+*/
+template <class Alloc> static void ProducerConsumer(benchmark::State &state) {
+  struct Channel {
+    std::mutex mutex;
+    std::deque<Batch> batches;
+    bool push(const Batch &batch) {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (batches.size() == 16) {
+        return false;
+      }
+      batches.push_back(batch);
+      return true;
+    }
+    bool pop(Batch &batch) {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (batches.empty()) {
+        return false;
+      }
+      batch = batches.front();
+      batches.pop_front();
+      return true;
+    }
+  };
+  static Channel channels[32];
+  Channel &channel = channels[state.thread_index() / 2];
+  bool producer = state.thread_index() % 2 == 0;
+  Alloc alloc;
+  Random random{(uint64_t)state.thread_index() + 1};
+  for (auto _ : state) {
+    Batch batch;
+    if (producer) {
+      for (auto &entry : batch.entries) {
+        entry = allocate_entry(alloc, random_units(random));
+      }
+      // consumer falls behind, wait for it
+      while (!channel.push(batch)) {
+        std::this_thread::yield();
+      }
+    } else {
+      while (!channel.pop(batch)) {
+        std::this_thread::yield();
+      }
+      for (auto &entry : batch.entries) {
+        deallocate_entry(alloc, entry);
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 64 / 2);
+  if (state.thread_index() == 0) {
+    report_rss(state);
+  }
+}
+
+/*
+After xmalloc-test, every thread allocates batches into one shared queue
+and releases the oldest batch in it, mostly allocated by another thread.
+*/
+template <class Alloc> static void Xmalloc(benchmark::State &state) {
+  static std::mutex mutex;
+  static std::deque<Batch> queue;
+  Alloc alloc;
+  Random random{(uint64_t)state.thread_index() + 1};
+  size_t keep = 2 * state.threads();
+  for (auto _ : state) {
+    Batch batch;
+    for (auto &entry : batch.entries) {
+      entry = allocate_entry(alloc, random_units(random));
+    }
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      queue.push_back(batch);
+      if (queue.size() <= keep) {
+        continue;
+      }
+      batch = queue.front();
+      queue.pop_front();
+    }
+    for (auto &entry : batch.entries) {
+      deallocate_entry(alloc, entry);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 64);
+  if (state.thread_index() == 0) {
+    report_rss(state);
+  }
+  // the last thread out finds the queue empty afterwards
+  std::lock_guard<std::mutex> guard(mutex);
+  for (auto &batch : queue) {
+    for (auto &entry : batch.entries) {
+      deallocate_entry(alloc, entry);
+    }
+  }
+  queue.clear();
+}
+
+/*
+After larson, a thread replaces random blocks of its own set, once in a
+while it swaps the whole set with the one left by another thread, like a
+server handing connections over to other workers.
+*/
+template <class Alloc> static void Larson(benchmark::State &state) {
+  static std::mutex mutex;
+  static std::vector<Entry> mailbox;
+  Alloc alloc;
+  Random random{(uint64_t)state.thread_index() + 1};
+  std::vector<Entry> blocks;
+  auto fill = [&]() {
+    blocks.resize(1024);
+    for (auto &entry : blocks) {
+      entry = allocate_entry(alloc, 1 + random.next() % 16);
+    }
+  };
+  fill();
+  size_t round = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < 64; i++) {
+      Entry &entry = blocks[random.next() % blocks.size()];
+      deallocate_entry(alloc, entry);
+      entry = allocate_entry(alloc, 1 + random.next() % 16);
+    }
+    if (++round % 16 == 0) {
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        std::swap(blocks, mailbox);
+      }
+      if (blocks.empty()) {
+        fill();
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 64);
+  if (state.thread_index() == 0) {
+    report_rss(state);
+  }
+  for (auto &entry : blocks) {
+    deallocate_entry(alloc, entry);
+  }
+  std::lock_guard<std::mutex> guard(mutex);
+  for (auto &entry : mailbox) {
+    deallocate_entry(alloc, entry);
+  }
+  mailbox.clear();
+}
+
+/*
+Time every allocate and deallocate of mixed sizes, tail latency comes from
+slow paths such as refilling a thread cache or mapping new memory.
+*/
+template <class Alloc> static void Latency(benchmark::State &state) {
+  using Clock = std::chrono::steady_clock;
+  Alloc alloc;
+  Random random{(uint64_t)state.thread_index() + 1};
+  Entry entries[256];
+  std::vector<uint32_t> latencies;
+  latencies.reserve(1 << 20);
+  auto record = [&latencies](Clock::time_point begin) {
+    if (latencies.size() < latencies.capacity()) {
+      latencies.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               begin)
+              .count());
+    }
+  };
+  for (auto _ : state) {
+    for (auto &entry : entries) {
+      size_t units = random_units(random);
+      auto begin = Clock::now();
+      entry = allocate_entry(alloc, units);
+      record(begin);
+    }
+    for (auto &entry : entries) {
+      auto begin = Clock::now();
+      deallocate_entry(alloc, entry);
+      record(begin);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * 256);
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return (double)latencies[(size_t)(p * (latencies.size() - 1))];
+  };
+  state.counters["p50_ns"] =
+      benchmark::Counter(percentile(0.5), benchmark::Counter::kAvgThreads);
+  state.counters["p99_ns"] =
+      benchmark::Counter(percentile(0.99), benchmark::Counter::kAvgThreads);
+  state.counters["p999_ns"] =
+      benchmark::Counter(percentile(0.999), benchmark::Counter::kAvgThreads);
+  state.counters["max_ns"] =
+      benchmark::Counter(latencies.back(), benchmark::Counter::kAvgThreads);
+}
+
+/*
+Allocation trace, one request per line:
+  a <id> <size>   allocate size bytes as object id
+  f <id>          release object id
+It is read from the file named by SQRL_ALLOCATOR_TRACE, otherwise a trace
+of mixed sizes and lifetimes is made up.
+*/
+struct TraceOp {
+  bool allocate;
+  uint32_t id;
+  uint32_t units;
+};
+
+struct Trace {
+  std::vector<TraceOp> ops;
+  size_t ids = 0;
+};
+
+static bool read_trace(const char *path, Trace &trace) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    return false;
+  }
+  char op;
+  unsigned long id;
+  unsigned long size = 0;
+  while (fscanf(file, " %c %lu", &op, &id) == 2) {
+    if (op == 'a' && fscanf(file, "%lu", &size) != 1) {
+      break;
+    }
+    uint32_t units = (size + sizeof(Unit) - 1) / sizeof(Unit);
+    trace.ops.push_back(TraceOp{op == 'a', (uint32_t)id, units ? units : 1});
+    trace.ids = std::max(trace.ids, (size_t)id + 1);
+  }
+  fclose(file);
+  return true;
+}
+
+static void make_trace(Trace &trace) {
+  Random random{1234};
+  std::vector<uint32_t> live;
+  for (uint32_t id = 0; id < 100000; id++) {
+    trace.ops.push_back(TraceOp{true, id, (uint32_t)random_units(random)});
+    live.push_back(id);
+    // most objects die young, some live long
+    while (!live.empty() && random.next() % 8 < 7) {
+      size_t index = random.next() % live.size();
+      index = random.next() % 4 == 0 ? index : live.size() - 1;
+      trace.ops.push_back(TraceOp{false, live[index], 0});
+      live[index] = live.back();
+      live.pop_back();
+    }
+  }
+  trace.ids = 100000;
+}
+
+static const Trace &get_trace() {
+  static Trace trace;
+  static std::once_flag once;
+  std::call_once(once, []() {
+    const char *path = getenv("SQRL_ALLOCATOR_TRACE");
+    if (path == nullptr || !read_trace(path, trace)) {
+      make_trace(trace);
+    }
+  });
+  return trace;
+}
+
+template <class Alloc> static void TraceReplay(benchmark::State &state) {
+  const Trace &trace = get_trace();
+  Alloc alloc;
+  std::vector<Entry> objects(trace.ids, Entry{nullptr, 0});
+  size_t peak_rss = 0;
+  size_t replayed = 0;
+  for (auto _ : state) {
+    for (const TraceOp &op : trace.ops) {
+      Entry &object = objects[op.id];
+      if (op.allocate) {
+        // an id allocated again without release in between is replaced
+        deallocate_entry(alloc, object);
+        object = allocate_entry(alloc, op.units);
+      } else {
+        deallocate_entry(alloc, object);
+      }
+      if (++replayed % 65536 == 0) {
+        peak_rss = std::max(peak_rss, resident_size());
+      }
+    }
+    for (auto &object : objects) {
+      deallocate_entry(alloc, object);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * trace.ops.size());
+  peak_rss = std::max(peak_rss, resident_size());
+  state.counters["rss"] = benchmark::Counter(
+      peak_rss, benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+
+BENCHMARK_TEMPLATE(MixedSizes, std::allocator<Unit>);
+BENCHMARK_TEMPLATE(MixedSizes, sqrl::Allocator<Unit>);
+BENCHMARK_TEMPLATE(MixedSizes, sqrl::PoolAllocator<Unit>);
+BENCHMARK_TEMPLATE(MixedSizes, sqrl::ArenaAllocator<Unit>);
+
+BENCHMARK_TEMPLATE(Churn, std::allocator<Unit>)->Arg(1 << 12)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(Churn, sqrl::Allocator<Unit>)->Arg(1 << 12)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(Churn, sqrl::PoolAllocator<Unit>)->Arg(1 << 12)->Arg(1 << 16);
+
+// allocators below are shared between threads, a pool or an arena is not,
+// rss is reported by the first thread only
+BENCHMARK_TEMPLATE(ProducerConsumer, std::allocator<Unit>)
+    ->ThreadRange(2, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(ProducerConsumer, sqrl::Allocator<Unit>)
+    ->ThreadRange(2, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(Xmalloc, std::allocator<Unit>)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(Xmalloc, sqrl::Allocator<Unit>)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(Larson, std::allocator<Unit>)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(Larson, sqrl::Allocator<Unit>)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+BENCHMARK_TEMPLATE(Latency, std::allocator<Unit>)->Threads(1)->Threads(4);
+BENCHMARK_TEMPLATE(Latency, sqrl::Allocator<Unit>)->Threads(1)->Threads(4);
+BENCHMARK_TEMPLATE(Latency, sqrl::PoolAllocator<Unit>);
+
+BENCHMARK_TEMPLATE(TraceReplay, std::allocator<Unit>);
+BENCHMARK_TEMPLATE(TraceReplay, sqrl::Allocator<Unit>);
+BENCHMARK_TEMPLATE(TraceReplay, sqrl::PoolAllocator<Unit>);
+
+BENCHMARK_MAIN();
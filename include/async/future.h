@@ -55,7 +55,7 @@ public:
   }
   bool valid() { return !state.is_null(); }
   void wait() {
-    std::unique_lock<std::mutex> lock;
+    std::unique_lock<std::mutex> lock(state->mutex);
     while (!state->ready) {
       state->cvar.wait(lock);
     }
@@ -111,6 +111,7 @@ public:
   void set_value() {
     static_assert(sqrl::is_same_v<T, void>,
                   "Promise<T> while T is not void should not use set_value()");
+    std::lock_guard<std::mutex> lock(state->mutex);
     state->ready = true;
     state->cvar.notify_all();
   }
@@ -0,0 +1,164 @@
+#ifndef INCLUDED_MPMC_QUEUE_H
+#define INCLUDED_MPMC_QUEUE_H
+
+#include <atomic>
+#include <container/queue.h>
+#include <memory/allocator.h>
+#include <memory/destroy.h>
+#include <new>
+#include <utility>
+
+namespace sqrl {
+
+/*
+MPMCQueue
+Bounded lock free queue for many producers and many consumers. Capacity is
+rounded up to a power of two, at least 2, and never grows.
+
+Every slot carries a sequence number telling whose turn it is:
+- sequence == position, the slot is free for the producer of position
+- sequence == position + 1, it holds the element for the consumer of
+  position, who frees it for position + capacity of next round
+A producer or consumer claims a position by CAS on tail or head, which sit
+on cache lines of their own. try_ operations fail at once if the queue is
+full or empty, the others wait for room or an element.
+*/
+template <typename T, typename Alloc = sqrl::Allocator<T>> class MPMCQueue {
+public:
+  MPMCQueue(size_t queue_size = SQRL_QUEUE_DEFAULT_INIT_SIZE,
+            const Alloc &alloc = Alloc())
+      : _allocator(alloc) {
+    // with one slot the sequence of a full slot is that of the next free
+    // position, a push would overwrite it
+    _capacity = 2;
+    while (_capacity < queue_size) {
+      _capacity <<= 1;
+    }
+    _mask = _capacity - 1;
+    _slots = _allocator.allocate(_capacity);
+    for (size_t i = 0; i < _capacity; i++) {
+      new (&_slots[i].sequence) std::atomic<size_t>(i);
+    }
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+  }
+
+  MPMCQueue(const MPMCQueue &) = delete;
+  MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+  // no thread is supposed to use it any more
+  ~MPMCQueue() {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for (size_t i = _head.load(std::memory_order_relaxed); i != tail; i++) {
+      destroy_at(_slots[i & _mask].data());
+    }
+    _allocator.deallocate(_slots, _capacity);
+  }
+
+  template <typename... Args> bool try_emplace(Args &&...args) {
+    size_t position = _tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &_slots[position & _mask];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // consumer of last round has not freed it, full
+        return false;
+      } else {
+        position = _tail.load(std::memory_order_relaxed);
+      }
+    }
+    new (slot->data()) T(std::forward<Args>(args)...);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(const T &t) { return try_emplace(t); }
+
+  bool try_push(T &&t) { return try_emplace(std::move(t)); }
+
+  // move the front element to {out}
+  bool try_pop(T &out) {
+    size_t position = _head.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &_slots[position & _mask];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)(position + 1);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // producer has not filled it, empty
+        return false;
+      } else {
+        position = _head.load(std::memory_order_relaxed);
+      }
+    }
+    out = std::move(*slot->data());
+    destroy_at(slot->data());
+    slot->sequence.store(position + _capacity, std::memory_order_release);
+    return true;
+  }
+
+  // wait for room
+  template <typename... Args> void emplace(Args &&...args) {
+    size_t spins = 0;
+    // arguments are not moved from unless it succeeds
+    while (!try_emplace(std::forward<Args>(args)...)) {
+      _queue_backoff(spins);
+    }
+  }
+
+  void push(const T &t) { emplace(t); }
+
+  void push(T &&t) { emplace(std::move(t)); }
+
+  // wait for an element
+  void pop(T &out) {
+    size_t spins = 0;
+    while (!try_pop(out)) {
+      _queue_backoff(spins);
+    }
+  }
+
+  // a snapshot, it may be out of date once returned
+  size_t size() const {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t capacity() const { return _capacity; }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    alignas(T) unsigned char storage[sizeof(T)];
+    T *data() { return (T *)storage; }
+  };
+
+  // written once by constructor, read by everyone
+  Slot *_slots;
+  size_t _capacity;
+  size_t _mask;
+  typename AllocatorTraits<Alloc>::template rebind<Slot> _allocator;
+  // next position to pop
+  alignas(SQRL_QUEUE_CACHE_LINE) std::atomic<size_t> _head;
+  // next position to push
+  alignas(SQRL_QUEUE_CACHE_LINE) std::atomic<size_t> _tail;
+};
+
+}; // namespace sqrl
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef INCLUDED_MPSC_QUEUE_H
+#define INCLUDED_MPSC_QUEUE_H
+
+#include <atomic>
+#include <container/queue.h>
+#include <memory/allocator.h>
+#include <memory/destroy.h>
+#include <new>
+#include <utility>
+
+namespace sqrl {
+
+// link of an element in MPSCQueue, elements derive from it
+struct MPSCNode {
+  std::atomic<MPSCNode *> _next{nullptr};
+};
+
+/*
+MPSCQueue
+Unbounded lock free queue for many producers and one consumer, elements
+are linked through their own MPSCNode and never copied or allocated.
+
+After Vyukov's intrusive queue: a producer swaps itself in as tail by one
+exchange and then links the previous tail to it. Between the two steps
+the element is not reachable yet, pop returns nullptr as if it were
+empty. The consumer walks from head, a stub node stands in once the last
+element is taken.
+*/
+template <typename Node> class MPSCQueue {
+public:
+  MPSCQueue() : _tail(&_stub), _head(&_stub) {}
+
+  MPSCQueue(const MPSCQueue &) = delete;
+  MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+  // any thread
+  void push(Node *node) { _push(node); }
+
+  // consumer only, nullptr if there is nothing to take
+  Node *pop() {
+    MPSCNode *head = _head;
+    MPSCNode *next = head->_next.load(std::memory_order_acquire);
+    if (head == &_stub) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      _head = next;
+      head = next;
+      next = next->_next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      _head = next;
+      return static_cast<Node *>(head);
+    }
+    if (head != _tail.load(std::memory_order_acquire)) {
+      // a producer is linking the next element
+      return nullptr;
+    }
+    // head is the last element, stub takes its place
+    _push(&_stub);
+    next = head->_next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      _head = next;
+      return static_cast<Node *>(head);
+    }
+    return nullptr;
+  }
+
+  // consumer only, take up to {max} elements, return how many are taken
+  size_t pop_n(Node **out, size_t max) {
+    size_t n = 0;
+    while (n < max && (out[n] = pop()) != nullptr) {
+      n++;
+    }
+    return n;
+  }
+
+  // a snapshot, it may be out of date once returned
+  bool empty() const { return _tail.load(std::memory_order_acquire) == &_stub; }
+
+private:
+  // exchanged by producers
+  alignas(SQRL_QUEUE_CACHE_LINE) std::atomic<MPSCNode *> _tail;
+  // owned by consumer
+  alignas(SQRL_QUEUE_CACHE_LINE) MPSCNode *_head;
+  MPSCNode _stub;
+
+  void _push(MPSCNode *node) {
+    node->_next.store(nullptr, std::memory_order_relaxed);
+    MPSCNode *prev = _tail.exchange(node, std::memory_order_acq_rel);
+    prev->_next.store(node, std::memory_order_release);
+  }
+};
+
+/*
+Inbox
+Submission inbox on top of MPSCQueue, any thread pushes values and one
+dispatcher drains them in batches. Nodes come from the allocator, the
+default one keeps released small blocks in per thread magazines, so a
+steady flow of submissions reuses them without the central heap.
+*/
+template <typename T, typename Alloc = sqrl::Allocator<T>> class Inbox {
+  struct Node : MPSCNode {
+    template <typename... Args>
+    Node(Args &&...args) : value(std::forward<Args>(args)...) {}
+    T value;
+  };
+
+public:
+  Inbox(const Alloc &alloc = Alloc()) : _allocator(alloc) {}
+
+  Inbox(const Inbox &) = delete;
+  Inbox &operator=(const Inbox &) = delete;
+
+  // neither producers nor dispatcher are supposed to use it any more
+  ~Inbox() {
+    while (Node *node = _queue.pop()) {
+      _release(node);
+    }
+  }
+
+  // any thread
+  template <typename... Args> void emplace(Args &&...args) {
+    Node *node = _allocator.allocate(1);
+    new (node) Node(std::forward<Args>(args)...);
+    _queue.push(node);
+  }
+
+  void push(const T &t) { emplace(t); }
+
+  void push(T &&t) { emplace(std::move(t)); }
+
+  // dispatcher only, move the oldest value to {out}
+  bool try_pop(T &out) {
+    Node *node = _queue.pop();
+    if (node == nullptr) {
+      return false;
+    }
+    out = std::move(node->value);
+    _release(node);
+    return true;
+  }
+
+  // dispatcher only, move up to {max} oldest values to {out}, return how
+  // many are taken
+  size_t drain(T *out, size_t max) {
+    size_t n = 0;
+    while (n < max && try_pop(out[n])) {
+      n++;
+    }
+    return n;
+  }
+
+  bool empty() const { return _queue.empty(); }
+
+private:
+  MPSCQueue<Node> _queue;
+  typename AllocatorTraits<Alloc>::template rebind<Node> _allocator;
+
+  void _release(Node *node) {
+    destroy_at(node);
+    _allocator.deallocate(node, 1);
+  }
+};
+
+}; // namespace sqrl
+
+#endif
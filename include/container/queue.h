@@ -1,83 +1,251 @@
 #ifndef INCLUDED_QUEUE_H
 #define INCLUDED_QUEUE_H
 
+#include <cstring>
 #include <memory/allocator.h>
 #include <memory/destroy.h>
+#include <new>
+#include <thread>
+#include <type_traits>
 #include <utility>
 
-#define SQRL_QUEUE_DEFAULT_INIT_SIZE 50
+#define SQRL_QUEUE_DEFAULT_INIT_SIZE 64
+// indices shared by threads sit on lines of their own
+#define SQRL_QUEUE_CACHE_LINE 64
 
 namespace sqrl {
 
-template <typename T> class Queue {
+// a blocked thread of a concurrent queue spins for a while, then yields
+inline void _queue_backoff(size_t &spins) {
+  if (spins++ < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } else {
+    std::this_thread::yield();
+  }
+}
+
+// copy {n} elements into a queue space
+template <typename T> void _queue_copy_n(T *to, const T *from, size_t n) {
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    if (n != 0) {
+      memcpy((void *)to, (const void *)from, n * sizeof(T));
+    }
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      new (to + i) T(from[i]);
+    }
+  }
+}
+
+// move {n} elements out of a queue space to existing objects of {to}
+template <typename T> void _queue_move_n(T *to, T *from, size_t n) {
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    if (n != 0) {
+      memcpy((void *)to, (const void *)from, n * sizeof(T));
+    }
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      to[i] = std::move(from[i]);
+      destroy_at(from + i);
+    }
+  }
+}
+
+/*
+Queue
+Ring buffer of a power of two capacity, positions wrap around by a mask.
+A full queue doubles its space, elements are relocated in order to the
+start of the new one like in Vector.
+*/
+template <typename T, typename Alloc = sqrl::Allocator<T>> class Queue {
 public:
-  // constructor
-  Queue(size_t queue_size = SQRL_QUEUE_DEFAULT_INIT_SIZE) {
-    _init_space(queue_size);
+  // constructor, capacity is rounded up to a power of two
+  Queue(size_t queue_size = SQRL_QUEUE_DEFAULT_INIT_SIZE,
+        const Alloc &alloc = Alloc())
+      : _allocator(alloc) {
+    _init_space(_round_up(queue_size));
+  }
+
+  // take over memory together with its allocator
+  Queue(Queue &&other) noexcept : _allocator(std::move(other._allocator)) {
+    _steal(other);
+  }
+
+  Queue &operator=(Queue &&other) {
+    if (this == &other) {
+      return *this;
+    }
+    if constexpr (AllocatorTraits<Alloc>::propagate_on_move) {
+      _deallocate();
+      _allocator = std::move(other._allocator);
+      _steal(other);
+    } else {
+      // memory of other belongs to its allocator, move elements one by one
+      _deallocate();
+      if (other._capacity == 0) {
+        _empty_space();
+      } else {
+        _init_space(other._capacity);
+      }
+      while (!other.empty()) {
+        emplace(std::move(other.front()));
+        other.pop();
+      }
+    }
+    return *this;
   }
 
   inline bool empty() { return _count == 0; }
 
+  // next push grows the space
   inline bool full() { return _count == _capacity; }
 
-  void push(const T &t) {
-    T *current = _root + _tail;
-    *current = t;
-    _push();
-  }
+  void push(const T &t) { emplace(t); }
 
-  void pop() { _pop(); }
+  void push(T &&t) { emplace(std::move(t)); }
 
-  T &front() const {
-    T *front = _root + _head;
-    return *front;
+  // destroy the front element
+  void pop() {
+    destroy_at(_root + _head);
+    _count--;
+    _head = (_head + 1) & _mask;
   }
 
+  T &front() const { return *(_root + _head); }
+
   template <typename... Args> void emplace(Args &&...args) {
-    new (_root + _tail) T(std::forward<Args>(args)...);
-    _push();
+    if (full()) {
+      _grow_emplace(std::forward<Args>(args)...);
+    } else {
+      new (_root + _tail()) T(std::forward<Args>(args)...);
+    }
+    _count++;
+  }
+
+  // push copies of {n} elements, which are not part of this queue
+  void push_n(const T *items, size_t n) {
+    if (_count + n > _capacity) {
+      _relocate(_round_up(_count + n));
+    }
+    size_t tail = _tail();
+    // elements wrap around at most once
+    size_t first = n < _capacity - tail ? n : _capacity - tail;
+    _queue_copy_n(_root + tail, items, first);
+    _queue_copy_n(_root, items + first, n - first);
+    _count += n;
+  }
+
+  // move up to {n} front elements to {out}, return how many are popped
+  size_t pop_n(T *out, size_t n) {
+    if (n > _count) {
+      n = _count;
+    }
+    size_t first = n < _capacity - _head ? n : _capacity - _head;
+    _queue_move_n(out, _root + _head, first);
+    _queue_move_n(out + first, _root, n - first);
+    _count -= n;
+    _head = (_head + n) & _mask;
+    return n;
   }
 
   inline size_t size() { return _count; }
 
-  ~Queue() { _deallocate(_root); }
-  // do not allow resize
+  inline size_t capacity() const { return _capacity; }
+
+  Alloc get_allocator() const { return _allocator; }
+
+  ~Queue() { _deallocate(); }
 
 private:
   T *_root;
   size_t _head;
-  size_t _tail;
   size_t _count;
   size_t _capacity;
-  sqrl::Allocator<T> _allocator;
+  // _capacity - 1
+  size_t _mask;
+  Alloc _allocator;
+
+  static size_t _round_up(size_t size) {
+    size_t capacity = 1;
+    while (capacity < size) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  inline size_t _tail() const { return (_head + _count) & _mask; }
 
   void _init_space(size_t capacity) {
     _capacity = capacity;
+    _mask = capacity - 1;
     _root = _allocate(capacity);
     _head = 0;
-    _tail = 0;
+    _count = 0;
+  }
+
+  // no space till an element comes, a moved queue is left so
+  void _empty_space() {
+    _root = nullptr;
+    _capacity = 0;
+    _mask = 0;
+    _head = 0;
     _count = 0;
   }
 
   // TODO: does it work fine with objects with virtual?
   T *_allocate(size_t capacity) { return _allocator.allocate(capacity); }
 
-  void _deallocate(T *begin) {
-    destroy_n(begin, _count);
-    _allocator.deallocate(begin, _capacity);
+  void _free_space() {
+    if (_root != nullptr) {
+      _allocator.deallocate(_root, _capacity);
+    }
   }
 
-  inline void _push() {
-    _count++;
-    _tail = (_tail + 1) % _capacity;
+  void _deallocate() {
+    for (size_t i = 0; i < _count; i++) {
+      destroy_at(_root + ((_head + i) & _mask));
+    }
+    _free_space();
   }
 
-  inline void _pop() {
-    _count--;
-    _head = (_head + 1) % _capacity;
+  // arguments may refer to an element, it is built before relocation
+  template <typename... Args> void _grow_emplace(Args &&...args) {
+    size_t new_capacity =
+        _capacity == 0 ? SQRL_QUEUE_DEFAULT_INIT_SIZE : _capacity * 2;
+    T *new_root = _allocate(new_capacity);
+    new (new_root + _count) T(std::forward<Args>(args)...);
+    _relocate_to(new_root, new_capacity);
+  }
+
+  void _relocate(size_t new_capacity) {
+    _relocate_to(_allocate(new_capacity), new_capacity);
+  }
+
+  // elements are placed in order from the start of the new space
+  void _relocate_to(T *new_root, size_t new_capacity) {
+    size_t first = _count < _capacity - _head ? _count : _capacity - _head;
+    relocate_n(new_root, _root + _head, first);
+    relocate_n(new_root + first, _root, _count - first);
+    _free_space();
+    _root = new_root;
+    _head = 0;
+    _capacity = new_capacity;
+    _mask = new_capacity - 1;
+  }
+
+  void _steal(Queue &other) {
+    _root = other._root;
+    _head = other._head;
+    _count = other._count;
+    _capacity = other._capacity;
+    _mask = other._mask;
+    // other has no space left, its next element allocates one
+    other._empty_space();
   }
 };
 
 }; // namespace sqrl
 
-#endif
\ No newline at end of file
+#endif
@@ -1,207 +1,141 @@
 #ifndef INCLUDED_SAFE_QUEUE_H
 #define INCLUDED_SAFE_QUEUE_H
 
-#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <container/queue.h>
 #include <mutex>
 #include <utility>
 
-#define MAX_QUEUE_NUM 50
-
 namespace sqrl {
 
-template <typename T> class SafeQueue : Queue<T> {
+/*
+SafeQueue
+Queue guarded by a mutex for any number of producers and consumers, it
+grows like Queue. Consumers park on a condition variable till an element
+comes or the queue is closed:
+- wait_and_pop waits as long as it takes
+- try_pop_for waits up to a timeout
+- try_pop and drain never wait
+Once closed, pushes are refused and waiting consumers wake up, elements
+left can still be popped.
+*/
+template <typename T, typename Alloc = sqrl::Allocator<T>> class SafeQueue {
 public:
-  SafeQueue(size_t queue_size = MAX_QUEUE_NUM) { _init_space(queue_size); }
+  SafeQueue(size_t queue_size = SQRL_QUEUE_DEFAULT_INIT_SIZE,
+            const Alloc &alloc = Alloc())
+      : _queue(queue_size, alloc) {}
+
+  SafeQueue(const SafeQueue &) = delete;
+  SafeQueue &operator=(const SafeQueue &) = delete;
 
-  ~SafeQueue() {
-    std::unique_lock<std::mutex> guard(lock);
-    _deallocate(_root);
+  bool push(const T &t) { return emplace(t); }
+
+  bool push(T &&t) { return emplace(std::move(t)); }
+
+  // false if closed
+  template <typename... Args> bool emplace(Args &&...args) {
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      if (_closed) {
+        return false;
+      }
+      _queue.emplace(std::forward<Args>(args)...);
+    }
+    _not_empty.notify_one();
+    return true;
   }
 
-  inline bool empty() { return _count == 0; }
-  inline bool full() { return _count == _capacity; }
-  void push(const T &t) {
-    std::unique_lock<std::mutex> guard(lock);
-    size_t temp_tail = _tail;
-    T *current = _root + _tail;
-    *current = t;
-    _count++;
-    _tail = (temp_tail + 1) % _capacity;
+  // push copies of {n} elements under one lock, false if closed
+  bool push_n(const T *items, size_t n) {
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      if (_closed) {
+        return false;
+      }
+      _queue.push_n(items, n);
+    }
+    _not_empty.notify_all();
+    return true;
   }
+
+  // drop the front element if any
   void pop() {
-    std::unique_lock<std::mutex> guard(lock);
-    size_t temp_head = _head;
-    _count--;
-    _head = (temp_head + 1) % _capacity;
-  }
-  T &front() const {
-    T *front = _root + _head;
-    return *front;
-  }
-  template <typename... Args> void emplace(Args &&...args) {
-    std::unique_lock<std::mutex> guard(lock);
-    size_t temp_tail = _tail;
-    T *current = new (_root + _tail) T(std::forward<Args>(args)...);
-    _tail = (temp_tail + 1) % _capacity;
-  }
-  size_t size() {
-    if (empty()) {
-      return 0;
-    }
-    if (full()) {
-      return _capacity;
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (!_queue.empty()) {
+      _queue.pop();
     }
-    return _tail < _head ? (_tail + _capacity - _head) : (_tail - _head);
   }
 
-private:
-  T *_root;
-  std::atomic<size_t> _head;
-  std::atomic<size_t> _tail;
-  std::atomic<size_t> _count;
-  std::atomic<size_t> _capacity;
-  std::mutex lock;
-  sqrl::Allocator<T> _allocator;
-
-  void _init_space(size_t capacity) {
-    _capacity = capacity;
-    _root = _allocate(capacity);
-    _head = 0;
-    _tail = 0;
-    _count = 0;
+  // move the front element to {out} if any
+  bool try_pop(T &out) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _take(out);
   }
 
-  // TODO: does it work fine with objects with virtual?
-  T *_allocate(size_t capacity) {
-    return _allocator.allocate(capacity + BUFFER);
+  // false only if closed and empty
+  bool wait_and_pop(T &out) {
+    std::unique_lock<std::mutex> guard(_mutex);
+    _not_empty.wait(guard, [this]() { return !_queue.empty() || _closed; });
+    return _take(out);
   }
 
-  void _deallocate(T *begin) { _allocator.deallocate(begin, 1); }
-};
-
-/*
-Still in experiment
-
-This Queue uses CAS to implement spinlock to achive threadsafe
-
-For adding new element it needs to compete the follwing items in given order:
-- compete for size(_count++)
-- compete for write address(_tail++)
-- compete for write access(state=free)
+  // false if nothing comes in {timeout}
+  template <typename Rep, typename Period>
+  bool try_pop_for(T &out, const std::chrono::duration<Rep, Period> &timeout) {
+    std::unique_lock<std::mutex> guard(_mutex);
+    _not_empty.wait_for(guard, timeout,
+                        [this]() { return !_queue.empty() || _closed; });
+    return _take(out);
+  }
 
-For poping element it also needs to compete the following items in given order:
-- compete for size(_count--)
-- compete for pop address(_head++)
-- compete for write access(state=ready)
-*/
-template <typename T> class BlockFreeQueue {
-public:
-  BlockFreeQueue(size_t queue_size = MAX_QUEUE_NUM) { _init_space(queue_size); }
-  ~BlockFreeQueue() {
-    _deallocate();
-    _deallocate();
+  // move up to {max} front elements to {out} under one lock, return how
+  // many are popped
+  size_t drain(T *out, size_t max) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _queue.pop_n(out, max);
   }
-  inline bool empty() { return _count == 0; }
-  inline bool full() { return _count == _capacity; }
-
-  size_t wait_for_push() {
-    size_t temp_count;
-    size_t new_count;
-    size_t temp_tail;
-    size_t new_tail;
-    // compete for size
-    do {
-      temp_count = _count;
-      new_count = temp_count + 1;
-    } while (new_count <= _capacity &&
-             !_count.compare_exchange_strong(temp_count, new_count));
-    // compete for a location
-    do {
-      temp_tail = _tail;
-      new_tail = (temp_tail + 1) % _capacity;
-    } while (!_tail.compare_exchange_strong(temp_tail, new_tail));
-    // compete for a location to be ready to write
-    State *current_state = _state_root + temp_tail;
-    state free_state = free;
-    while (!(*current_state).compare_exchange_strong(free_state, working)) {
-      free_state = free;
+
+  // refuse pushes from now on and wake up all waiting consumers
+  void close() {
+    {
+      std::lock_guard<std::mutex> guard(_mutex);
+      _closed = true;
     }
-    return temp_tail;
+    _not_empty.notify_all();
   }
 
-  void push(const T &t) {
-    size_t temp_tail = wait_for_push();
-    T *current_data = _data_root + temp_tail;
-    *current_data = t;
-    State *current_state = _state_root + temp_tail;
-    *current_state = ready;
+  bool closed() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _closed;
   }
 
-  template <typename... Args> void emplace(Args &&...args) {
-    size_t temp_tail = wait_for_push();
-    T *current = new (_data_root + temp_tail) T(std::forward<Args>(args)...);
-    State *current_state = _state_root + temp_tail;
-    *current_state = ready;
+  bool empty() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _queue.empty();
   }
 
-  void pop() {
-    size_t temp_count;
-    size_t new_count;
-    size_t temp_head;
-    size_t new_head;
-    do {
-      temp_count = _count;
-      new_count = temp_count - 1;
-    } while (new_count >= 0 &&
-             !_count.compare_exchange_strong(temp_count, new_count));
-    do {
-      temp_head = _head;
-      new_head = (temp_head + 1) % _capacity;
-    } while (!_head.compare_exchange_strong(temp_head, new_head));
-    State *current_state = _state_root + temp_head;
-    state ready_state = ready;
-    // wait for the address to ready
-    // maybe last push()/emplace() haven't finished
-    while (!(*current_state).compare_exchange_strong(ready_state, free)) {
-      ready_state = ready;
-    }
+  size_t size() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _queue.size();
   }
 
-  size_t size() { return _count; }
-
-  // TODO size, empty, full
 private:
-  enum state { free, working, ready };
-  typedef std::atomic<state> State;
-  std::atomic<size_t> _head;
-  std::atomic<size_t> _tail;
-  std::atomic<size_t> _count;
-  std::atomic<size_t> _capacity;
-  T *_data_root;
-  State *_state_root;
-  sqrl::Allocator<T> _allocator_t;
-  sqrl::Allocator<State> _allocator_s;
-
-  void _init_space(size_t capacity) {
-    _capacity = capacity;
-    _data_root = _allocator_t.allocate(capacity + BUFFER);
-    _state_root = _allocator_s.allocate(capacity + BUFFER);
-    _head = 0;
-    _tail = 0;
-    _count = 0;
-    // mark all blocks state to be free at very beginning
-    for (size_t i = 0; i < capacity; i++) {
-      State *temp = _state_root + i;
-      *temp = free;
+  Queue<T, Alloc> _queue;
+  std::mutex _mutex;
+  std::condition_variable _not_empty;
+  bool _closed = false;
+
+  // lock is held
+  bool _take(T &out) {
+    if (_queue.empty()) {
+      return false;
     }
-  }
-
-  void _deallocate() {
-    _allocator_t.deallocate(_data_root, 1);
-    _allocator_s.deallocate(_state_root, 1);
+    out = std::move(_queue.front());
+    _queue.pop();
+    return true;
   }
 };
 
 } // namespace sqrl
-#endif
\ No newline at end of file
+#endif
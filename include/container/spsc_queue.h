@@ -0,0 +1,182 @@
+#ifndef INCLUDED_SPSC_QUEUE_H
+#define INCLUDED_SPSC_QUEUE_H
+
+#include <atomic>
+#include <container/queue.h>
+#include <memory/allocator.h>
+#include <memory/destroy.h>
+#include <new>
+#include <utility>
+
+namespace sqrl {
+
+/*
+SPSCQueue
+Bounded wait free queue for exactly one producer thread and one consumer
+thread, a ring buffer of a power of two capacity like Queue.
+
+Head and tail count positions without wrapping, only the consumer writes
+head and only the producer writes tail. Each side publishes its index by
+a release store and reads the other one by an acquire load, which it
+caches and refreshes only once the cached one leaves too little room or
+too few elements. Both indices and their caches sit on cache lines of
+their own.
+*/
+template <typename T, typename Alloc = sqrl::Allocator<T>> class SPSCQueue {
+public:
+  SPSCQueue(size_t queue_size = SQRL_QUEUE_DEFAULT_INIT_SIZE,
+            const Alloc &alloc = Alloc())
+      : _allocator(alloc) {
+    _capacity = 1;
+    while (_capacity < queue_size) {
+      _capacity <<= 1;
+    }
+    _mask = _capacity - 1;
+    _root = _allocator.allocate(_capacity);
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+    _head_cache = 0;
+    _tail_cache = 0;
+  }
+
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  // neither side is supposed to use it any more
+  ~SPSCQueue() {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for (size_t i = _head.load(std::memory_order_relaxed); i != tail; i++) {
+      destroy_at(_root + (i & _mask));
+    }
+    _allocator.deallocate(_root, _capacity);
+  }
+
+  // producer side
+
+  template <typename... Args> bool try_emplace(Args &&...args) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (_room(tail, 1) == 0) {
+      return false;
+    }
+    new (_root + (tail & _mask)) T(std::forward<Args>(args)...);
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(const T &t) { return try_emplace(t); }
+
+  bool try_push(T &&t) { return try_emplace(std::move(t)); }
+
+  // wait for room
+  template <typename... Args> void emplace(Args &&...args) {
+    size_t spins = 0;
+    // arguments are not moved from unless it succeeds
+    while (!try_emplace(std::forward<Args>(args)...)) {
+      _queue_backoff(spins);
+    }
+  }
+
+  void push(const T &t) { emplace(t); }
+
+  void push(T &&t) { emplace(std::move(t)); }
+
+  // push copies of up to {n} elements, return how many there is room for
+  size_t push_n(const T *items, size_t n) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t room = _room(tail, n);
+    if (n > room) {
+      n = room;
+    }
+    size_t index = tail & _mask;
+    // elements wrap around at most once
+    size_t first = n < _capacity - index ? n : _capacity - index;
+    _queue_copy_n(_root + index, items, first);
+    _queue_copy_n(_root, items + first, n - first);
+    _tail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // consumer side
+
+  // move the front element to {out}
+  bool try_pop(T &out) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (_ready(head, 1) == 0) {
+      return false;
+    }
+    T *front = _root + (head & _mask);
+    out = std::move(*front);
+    destroy_at(front);
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // wait for an element
+  void pop(T &out) {
+    size_t spins = 0;
+    while (!try_pop(out)) {
+      _queue_backoff(spins);
+    }
+  }
+
+  // move up to {n} front elements to {out}, return how many are popped
+  size_t pop_n(T *out, size_t n) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t ready = _ready(head, n);
+    if (n > ready) {
+      n = ready;
+    }
+    size_t index = head & _mask;
+    size_t first = n < _capacity - index ? n : _capacity - index;
+    _queue_move_n(out, _root + index, first);
+    _queue_move_n(out + first, _root, n - first);
+    _head.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // a snapshot, it may be out of date once returned
+  size_t size() const {
+    // head first, tail only moves ahead of it so the difference never wraps
+    size_t head = _head.load(std::memory_order_acquire);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    return tail - head;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t capacity() const { return _capacity; }
+
+private:
+  // written once by constructor, read by both sides
+  T *_root;
+  size_t _capacity;
+  size_t _mask;
+  Alloc _allocator;
+  // written by consumer
+  alignas(SQRL_QUEUE_CACHE_LINE) std::atomic<size_t> _head;
+  size_t _tail_cache;
+  // written by producer
+  alignas(SQRL_QUEUE_CACHE_LINE) std::atomic<size_t> _tail;
+  size_t _head_cache;
+
+  // slots free for producer, head is loaded once cached one has less than
+  // {wanted}
+  size_t _room(size_t tail, size_t wanted) {
+    if (_capacity - (tail - _head_cache) < wanted) {
+      _head_cache = _head.load(std::memory_order_acquire);
+    }
+    return _capacity - (tail - _head_cache);
+  }
+
+  // elements ready for consumer, likewise
+  size_t _ready(size_t head, size_t wanted) {
+    if (_tail_cache - head < wanted) {
+      _tail_cache = _tail.load(std::memory_order_acquire);
+    }
+    return _tail_cache - head;
+  }
+};
+
+}; // namespace sqrl
+
+#endif
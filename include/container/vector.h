@@ -1,45 +1,109 @@
 #ifndef INCLUDED_VECTOR_H
 #define INCLUDED_VECTOR_H
 
+#include <cstring>
 #include <initializer_list>
+#include <iterator>
 #include <memory/allocator.h>
 #include <memory/destroy.h>
+#include <metaprogramming/types.h>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 #define SQRL_VECTOR_DEFAULT_INIT_SIZE 50
 
 namespace sqrl {
 
-template <typename T> class Vector {
+// growth policy of Vector, a full one grows by a factor of Num / Den
+template <size_t Num, size_t Den = 1> struct GrowthFactor {
+  static_assert(Num > Den, "Vector must grow");
+  static size_t grow(size_t capacity, size_t required) {
+    size_t grown = capacity * Num / Den;
+    return grown < required ? required : grown;
+  }
+};
+
+// a pair of iterators, not a count along with a value
+template <typename It>
+using _if_iterator = std::enable_if_t<!std::is_integral_v<It>>;
+
+/*
+Vector
+Elements are relocated to a larger space once it is full:
+- trivially relocatable ones by memcpy, or by reallocate of the allocator
+  which may grow the space in place
+- others are move constructed if it can't throw or they can't be copied,
+  otherwise copy constructed
+Capacity grows by Growth::grow(capacity, required), twice by default.
+Ranges of known size are placed at once, by memcpy if T is trivially
+copyable; constructors from them allocate exactly once.
+*/
+template <typename T, typename Alloc = sqrl::Allocator<T>,
+          typename Growth = GrowthFactor<2>>
+class Vector {
 public:
   // default constructor
   Vector() { _init_space(); }
+  // memory comes from given allocator, copies of it share its state
+  explicit Vector(const Alloc &alloc) : _allocator(alloc) { _init_space(); }
   // initialize with reserved capacity
-  Vector(int size) { _init_space(size); }
-  // initializer list
-  Vector(std::initializer_list<T> l) {
-    _init_space();
-    for (auto itr = l.begin(); itr != l.end(); itr++) {
-      push_back(*itr);
-    }
+  Vector(int size, const Alloc &alloc = Alloc()) : _allocator(alloc) {
+    _init_space(size);
   }
+  // {size} copies of {value}
+  Vector(size_t size, const T &value, const Alloc &alloc = Alloc())
+      : _allocator(alloc) {
+    _init_exact(size);
+    _construct_fill(_begin, size, value);
+    _top = size;
+  }
+  // initializer list
+  Vector(std::initializer_list<T> l, const Alloc &alloc = Alloc())
+      : Vector(l.begin(), l.end(), alloc) {}
 
   // shallow copy
-  Vector(const Vector<T> &v) {
-    _init_space();
-    for (auto itr = v.cbegin(); itr != v.cend(); itr++) {
-      push_back(*itr);
-    }
+  Vector(const Vector &v) : Vector(v.cbegin(), v.cend(), v._allocator) {}
+
+  // take over memory together with its allocator
+  Vector(Vector &&v) : _allocator(std::move(v._allocator)) {
+    _steal(v);
   }
 
-  // construct by iterator
-  Vector(const T *vbegin, const T *vend) {
-    _init_space();
-    if (vend <= vbegin) {
-      return;
+  Vector &operator=(Vector &&v) {
+    if (this == &v) {
+      return *this;
+    }
+    if constexpr (AllocatorTraits<Alloc>::propagate_on_move) {
+      _deallocate();
+      _allocator = std::move(v._allocator);
+      _steal(v);
+    } else {
+      // memory of v belongs to its allocator, move elements one by one
+      clear();
+      for (auto itr = v.begin(); itr != v.end(); itr++) {
+        emplace_back(std::move(*itr));
+      }
+      v.clear();
     }
-    for (auto itr = vbegin; itr != vend; itr++) {
-      push_back(*itr);
+    return *this;
+  }
+
+  // shallow copy, elements go to memory of this allocator
+  Vector &operator=(const Vector &v) {
+    if (this != &v) {
+      assign(v.cbegin(), v.cend());
     }
+    return *this;
+  }
+
+  // construct by forward iterators
+  template <typename It, typename = _if_iterator<It>>
+  Vector(It first, It last, const Alloc &alloc = Alloc()) : _allocator(alloc) {
+    size_t size = _range_size(first, last);
+    _init_exact(size);
+    _construct_range(_begin, first, last, size);
+    _top = size;
   }
 
   ~Vector() { _deallocate(); }
@@ -54,18 +118,16 @@ public:
 
   bool empty() { return _top == 0; }
 
-  void push_back(const T &t) {
-    _check_size(_top + 1);
-    T *current = _begin + _top;
-    *current = t;
-    _top++;
-  }
+  void push_back(const T &t) { emplace_back(t); }
+
+  void push_back(T &&t) { emplace_back(std::move(t)); }
 
   void pop_back() {
     if (empty()) {
       return;
     }
     _top--;
+    destroy_at(_begin + _top);
   }
 
   void clear() {
@@ -76,57 +138,355 @@ public:
   }
 
   template <typename... Args> void emplace_back(Args &&...args) {
-    _check_size(_top + 1);
-    // placement new is to create an object in existing address space
-    [[maybe_unused]] T *current =
-        new (_begin + _top) T(std::forward<Args>(args)...);
+    if (_top == _capacity) {
+      _grow_emplace(std::forward<Args>(args)...);
+    } else {
+      // placement new is to create an object in existing address space
+      new (_begin + _top) T(std::forward<Args>(args)...);
+    }
     _top++;
   }
 
   inline size_t size() { return _top; }
 
+  inline size_t capacity() const { return _capacity; }
+
+  // make room for {capacity} elements without relocation
+  void reserve(size_t capacity) {
+    if (capacity > _capacity) {
+      _relocate(capacity);
+    }
+  }
+
+  // give unused capacity back, one element is always kept
+  void shrink_to_fit() {
+    size_t capacity = _top == 0 ? 1 : _top;
+    if (capacity < _capacity) {
+      _relocate(capacity);
+    }
+  }
+
+  Alloc get_allocator() const { return _allocator; }
+
   inline T &operator[](size_t idx) { return *(_begin + idx); }
 
-  void resize(size_t new_capacity) {
-    T *new_begin = _allocate(new_capacity);
+  // new elements are value initialized
+  void resize(size_t size) {
+    if (size <= _top) {
+      _shrink(size);
+      return;
+    }
+    _reserve_for(size);
+    for (size_t i = _top; i < size; i++) {
+      new (_begin + i) T();
+    }
+    _top = size;
+  }
 
-    // copy old elements
-    for (size_t i = 0; i < _top; i++) {
-      T *current = new_begin + i;
-      T *previous = _begin + i;
-      *current = *previous;
+  void resize(size_t size, const T &value) {
+    if (size <= _top) {
+      _shrink(size);
+      return;
     }
-    // delete old stuffs
-    _deallocate();
-    // renew internal settings
-    _capacity = new_capacity;
-    _begin = new_begin;
+    // value may be an element to relocate
+    T t(value);
+    _reserve_for(size);
+    _construct_fill(_begin + _top, size - _top, t);
+    _top = size;
+  }
+
+  // replace elements by a range which is not part of this vector
+  template <typename It, typename = _if_iterator<It>>
+  void assign(It first, It last) {
+    size_t size = _range_size(first, last);
+    clear();
+    _reset_space(size);
+    _construct_range(_begin, first, last, size);
+    _top = size;
+  }
+
+  void assign(std::initializer_list<T> l) { assign(l.begin(), l.end()); }
+
+  void assign(size_t size, const T &value) {
+    T t(value);
+    clear();
+    _reset_space(size);
+    _construct_fill(_begin, size, t);
+    _top = size;
+  }
+
+  // insert a range which is not part of this vector before {pos}, return
+  // where it starts
+  template <typename It, typename = _if_iterator<It>>
+  T *insert(const T *pos, It first, It last) {
+    size_t index = pos - _begin;
+    size_t size = _range_size(first, last);
+    if (size == 0) {
+      return _begin + index;
+    }
+    if (_top + size > _capacity) {
+      size_t new_capacity = Growth::grow(_capacity, _top + size);
+      if constexpr (is_trivially_relocatable_v<T>) {
+        // may grow in place, elements are moved aside below
+        _relocate(new_capacity);
+      } else {
+        // the range is placed first, elements are relocated around it
+        T *new_begin = _allocate(new_capacity);
+        _construct_range(new_begin + index, first, last, size);
+        relocate_n(new_begin, _begin, index);
+        relocate_n(new_begin + index + size, _begin + index, _top - index);
+        _top += size;
+        _free_space();
+        _capacity = new_capacity;
+        _begin = new_begin;
+        _end = _begin + _capacity;
+        return _begin + index;
+      }
+    }
+    _relocate_backward(_begin + index + size, _begin + index, _top - index);
+    _construct_range(_begin + index, first, last, size);
+    _top += size;
+    return _begin + index;
+  }
+
+  template <typename Range> void append_range(const Range &range) {
+    insert(end(), std::begin(range), std::end(range));
   }
 
 protected:
-  sqrl::Allocator<T> _allocator;
+  // elements live in {buffer} of {capacity} till it is full, see SmallVector
+  Vector(T *buffer, size_t capacity, const Alloc &alloc)
+      : _allocator(alloc), _inline(buffer), _inline_capacity(capacity) {
+    _init_space();
+  }
+
+  Alloc _allocator;
   size_t _capacity;
   size_t _top;
   T *_begin;
   T *_end;
+  // space inside the vector itself, it is never given to allocator
+  T *_inline = nullptr;
+  size_t _inline_capacity = 0;
+  // a vector with inline space always starts from it
   void _init_space(size_t capacity = SQRL_VECTOR_DEFAULT_INIT_SIZE) {
-    _capacity = capacity;
     _top = 0;
-    _begin = _allocate(capacity);
+    if (_inline != nullptr) {
+      _capacity = _inline_capacity;
+      _begin = _inline;
+    } else {
+      _capacity = capacity;
+      _begin = _allocate(capacity);
+    }
     _end = _begin + _capacity;
   }
 
+  // a space of exactly {size} elements, an empty one gets the default
+  void _init_exact(size_t size) {
+    _init_space(size == 0 ? SQRL_VECTOR_DEFAULT_INIT_SIZE : size);
+  }
+  // no space of its own till an element comes, a moved vector is left so
+  void _empty_space() {
+    _top = 0;
+    if (_inline != nullptr) {
+      _capacity = _inline_capacity;
+      _begin = _inline;
+    } else {
+      _capacity = 0;
+      _begin = nullptr;
+    }
+    _end = _begin + _capacity;
+  }
+  // an empty vector takes a space for {size} elements without relocation
+  void _reset_space(size_t size) {
+    if (size <= _capacity) {
+      return;
+    }
+    _free_space();
+    if (_inline != nullptr && size <= _inline_capacity) {
+      _capacity = _inline_capacity;
+      _begin = _inline;
+    } else {
+      _capacity = size;
+      _begin = _allocate(size);
+    }
+    _end = _begin + _capacity;
+  }
+  void _reserve_for(size_t size) {
+    if (size > _capacity) {
+      _relocate(Growth::grow(_capacity, size));
+    }
+  }
+  void _shrink(size_t size) {
+    destroy_n(_begin + size, _top - size);
+    _top = size;
+  }
+  template <typename It> static size_t _range_size(It first, It last) {
+    static_assert(
+        std::is_base_of_v<std::forward_iterator_tag,
+                          typename std::iterator_traits<It>::iterator_category>,
+        "size of range must be known before placing it");
+    auto size = std::distance(first, last);
+    return size < 0 ? 0 : size;
+  }
+  // copy {size} elements of range to uninitialized {to}
+  template <typename It>
+  static void _construct_range(T *to, It first, It last, size_t size) {
+    using From = std::remove_cv_t<std::remove_pointer_t<It>>;
+    if constexpr (std::is_pointer_v<It> && std::is_same_v<From, T> &&
+                  std::is_trivially_copyable_v<T>) {
+      if (size != 0) {
+        memcpy((void *)to, (const void *)first, size * sizeof(T));
+      }
+    } else {
+      for (; first != last; ++first, ++to) {
+        new (to) T(*first);
+      }
+    }
+  }
+  static void _construct_fill(T *to, size_t size, const T &value) {
+    for (size_t i = 0; i < size; i++) {
+      new (to + i) T(value);
+    }
+  }
+
   // TODO: does it work fine with objects with virtual?
   T *_allocate(size_t capacity) { return _allocator.allocate(capacity); }
   void _deallocate() {
     destroy_n(_begin, _top);
-    _allocator.deallocate(_begin, _capacity);
+    _free_space();
+  }
+  void _free_space() {
+    if (_begin != _inline && _begin != nullptr) {
+      _allocator.deallocate(_begin, _capacity);
+    }
+  }
+  void _relocate(size_t new_capacity) {
+    // elements fitting in inline space go back there
+    if (_inline != nullptr && new_capacity <= _inline_capacity) {
+      if (_begin != _inline) {
+        _relocate_to(_inline, _inline_capacity);
+      }
+      return;
+    }
+    if constexpr (is_trivially_relocatable_v<T>) {
+      if constexpr (AllocatorTraits<Alloc>::can_reallocate) {
+        T *new_begin =
+            _begin == _inline || _begin == nullptr
+                ? nullptr
+                : _allocator.reallocate(_begin, _capacity, new_capacity);
+        if (new_begin != nullptr) {
+          _capacity = new_capacity;
+          _begin = new_begin;
+          _end = _begin + _capacity;
+          return;
+        }
+      }
+    }
+    _relocate_to(_allocate(new_capacity), new_capacity);
   }
-  void _check_size(size_t required) {
-    if (required > _capacity) {
-      resize(_capacity * 2);
+  // arguments may refer to an element, it is built before relocation
+  template <typename... Args> void _grow_emplace(Args &&...args) {
+    size_t new_capacity = Growth::grow(_capacity, _top + 1);
+    if constexpr (is_trivially_relocatable_v<T> &&
+                  AllocatorTraits<Alloc>::can_reallocate) {
+      // the space may be reallocated in place
+      T t(std::forward<Args>(args)...);
+      _relocate(new_capacity);
+      new (_begin + _top) T(std::move(t));
+    } else {
+      T *new_begin = _allocate(new_capacity);
+      new (new_begin + _top) T(std::forward<Args>(args)...);
+      _relocate_to(new_begin, new_capacity);
     }
   }
+  void _relocate_to(T *new_begin, size_t new_capacity) {
+    relocate_n(new_begin, _begin, _top);
+    // elements are gone already
+    _free_space();
+    _capacity = new_capacity;
+    _begin = new_begin;
+    _end = _begin + _capacity;
+  }
+  // relocate {size} elements to a higher address which may overlap them
+  static void _relocate_backward(T *to, T *from, size_t size) {
+    if constexpr (is_trivially_relocatable_v<T>) {
+      if (size != 0) {
+        memmove((void *)to, (const void *)from, size * sizeof(T));
+      }
+    } else {
+      for (size_t i = size; i > 0; i--) {
+        relocate_at(to + i - 1, from + i - 1);
+      }
+    }
+  }
+  void _steal(Vector &v) {
+    if (v._begin == v._inline) {
+      // inline space stays with v, take its elements one by one
+      _empty_space();
+      reserve(v._top);
+      for (size_t i = 0; i < v._top; i++) {
+        relocate_at(_begin + i, v._begin + i);
+      }
+      _top = v._top;
+      v._top = 0;
+      return;
+    }
+    _capacity = v._capacity;
+    _top = v._top;
+    _begin = v._begin;
+    _end = v._end;
+    // v has no space left, its next element allocates one
+    v._empty_space();
+  }
+};
+
+/*
+SmallVector
+Vector holding up to N elements in itself, memory is requested from the
+allocator only once it overflows. Short lists never touch the heap.
+*/
+template <typename T, size_t N, typename Alloc = sqrl::Allocator<T>,
+          typename Growth = GrowthFactor<2>>
+class SmallVector : public Vector<T, Alloc, Growth> {
+  static_assert(N > 0, "SmallVector needs inline space");
+  using Base = Vector<T, Alloc, Growth>;
+
+public:
+  SmallVector(const Alloc &alloc = Alloc()) : Base(_data(), N, alloc) {}
+  // initialize with reserved capacity
+  SmallVector(int size, const Alloc &alloc = Alloc())
+      : Base(_data(), N, alloc) {
+    this->reserve(size);
+  }
+  SmallVector(std::initializer_list<T> l, const Alloc &alloc = Alloc())
+      : Base(_data(), N, alloc) {
+    this->assign(l.begin(), l.end());
+  }
+  SmallVector(const SmallVector &v) : Base(_data(), N, v._allocator) {
+    this->assign(v.cbegin(), v.cend());
+  }
+  SmallVector(SmallVector &&v)
+      : Base(_data(), N, std::move(v._allocator)) {
+    this->_steal(v);
+  }
+  SmallVector &operator=(const SmallVector &v) {
+    Base::operator=(v);
+    return *this;
+  }
+  SmallVector &operator=(SmallVector &&v) {
+    Base::operator=(std::move(v));
+    return *this;
+  }
+  // elements go before their inline space does
+  ~SmallVector() { this->clear(); }
+
+  // elements are in inline space
+  bool is_inline() const { return this->_begin == this->_inline; }
+
+private:
+  alignas(T) unsigned char _buffer[N * sizeof(T)];
+  T *_data() { return (T *)_buffer; }
 };
 
 }; // namespace sqrl
@@ -0,0 +1,166 @@
+#ifndef INCLUDED_WORK_STEALING_DEQUE_H
+#define INCLUDED_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <container/queue.h>
+#include <cstdint>
+#include <memory/allocator.h>
+#include <new>
+#include <type_traits>
+
+namespace sqrl {
+
+/*
+WorkStealingDeque
+Chase-Lev deque of a growable ring buffer, after Le et al. for weak memory
+models. The owner thread pushes and pops at bottom like a stack, any other
+thread steals from top, the oldest element. Only the last element is
+raced for by CAS on top, the owner works on its own end without it.
+
+A full buffer is copied into one twice as large. Stealers may still read
+the old one, it is kept till the deque is destroyed.
+Elements are read while they may be overwritten, so T is trivially
+copyable, a pointer usually.
+*/
+template <typename T, typename Alloc = sqrl::Allocator<T>>
+class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are copied by racing threads");
+
+  struct Buffer {
+    int64_t capacity;
+    std::atomic<T> *slots;
+    // buffer replaced by this one
+    Buffer *retired;
+  };
+
+public:
+  WorkStealingDeque(size_t queue_size = SQRL_QUEUE_DEFAULT_INIT_SIZE,
+                    const Alloc &alloc = Alloc())
+      : _buffer_allocator(alloc), _slot_allocator(alloc) {
+    int64_t capacity = 1;
+    while (capacity < (int64_t)queue_size) {
+      capacity <<= 1;
+    }
+    _top.store(0, std::memory_order_relaxed);
+    _bottom.store(0, std::memory_order_relaxed);
+    _buffer.store(_new_buffer(capacity, nullptr), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  ~WorkStealingDeque() {
+    Buffer *buffer = _buffer.load(std::memory_order_relaxed);
+    while (buffer != nullptr) {
+      Buffer *retired = buffer->retired;
+      _slot_allocator.deallocate(buffer->slots, buffer->capacity);
+      _buffer_allocator.deallocate(buffer, 1);
+      buffer = retired;
+    }
+  }
+
+  // owner only
+  void push(T t) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    Buffer *buffer = _buffer.load(std::memory_order_relaxed);
+    if (bottom - top >= buffer->capacity) {
+      buffer = _grow(buffer, top, bottom);
+    }
+    _slot(buffer, bottom).store(t, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // owner only, take the latest element
+  bool pop(T &out) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    Buffer *buffer = _buffer.load(std::memory_order_relaxed);
+    // claim the bottom before looking at top
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      // empty
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+    out = _slot(buffer, bottom).load(std::memory_order_relaxed);
+    if (top < bottom) {
+      return true;
+    }
+    // the last element, stealers race for it
+    bool won = _top.compare_exchange_strong(
+        top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  // any thread, take the oldest element, false if empty or lost a race
+  bool steal(T &out) {
+    int64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return false;
+    }
+    Buffer *buffer = _buffer.load(std::memory_order_acquire);
+    T t = _slot(buffer, top).load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1,
+                                      std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    out = t;
+    return true;
+  }
+
+  // a snapshot, it may be out of date once returned
+  size_t size() const {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    return bottom > top ? bottom - top : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+private:
+  // raced for by stealers and the owner taking the last element
+  alignas(SQRL_QUEUE_CACHE_LINE) std::atomic<int64_t> _top;
+  // written by owner
+  alignas(SQRL_QUEUE_CACHE_LINE) std::atomic<int64_t> _bottom;
+  std::atomic<Buffer *> _buffer;
+  typename AllocatorTraits<Alloc>::template rebind<Buffer> _buffer_allocator;
+  typename AllocatorTraits<Alloc>::template rebind<std::atomic<T>>
+      _slot_allocator;
+
+  static std::atomic<T> &_slot(Buffer *buffer, int64_t index) {
+    return buffer->slots[index & (buffer->capacity - 1)];
+  }
+
+  Buffer *_new_buffer(int64_t capacity, Buffer *retired) {
+    Buffer *buffer = _buffer_allocator.allocate(1);
+    buffer->capacity = capacity;
+    buffer->slots = _slot_allocator.allocate(capacity);
+    for (int64_t i = 0; i < capacity; i++) {
+      new (&buffer->slots[i]) std::atomic<T>();
+    }
+    buffer->retired = retired;
+    return buffer;
+  }
+
+  Buffer *_grow(Buffer *buffer, int64_t top, int64_t bottom) {
+    Buffer *grown = _new_buffer(buffer->capacity * 2, buffer);
+    for (int64_t i = top; i < bottom; i++) {
+      _slot(grown, i).store(_slot(buffer, i).load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    }
+    _buffer.store(grown, std::memory_order_release);
+    return grown;
+  }
+};
+
+}; // namespace sqrl
+
+#endif
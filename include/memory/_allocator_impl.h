@@ -6,11 +6,43 @@ Internal implementation of allocator
 Not suppose to use directlly
 */
 
+#include <atomic>
+#include <cstring>
 #include <map>
 #include <memory/_block.h>
+#include <metaprogramming/types.h>
+#include <mutex>
+#include <string>
+#include <type_traits>
 
 // From M_MMAP_THRESHOLD from glibc
 #define SQRL_ALLOCATOR_MMAP_THRESHOLD 131072
+// From DEFAULT_MMAP_THRESHOLD_MAX from glibc, mmap threshold is raised up to
+// it by large blocks released
+#define SQRL_ALLOCATOR_MMAP_THRESHOLD_MAX (4 * 1024 * 1024 * sizeof(long))
+// released large mappings kept for reuse, by number and by total size
+#define SQRL_ALLOCATOR_MMAP_CACHE_NUM 8
+#define SQRL_ALLOCATOR_MMAP_CACHE_SIZE (256 << 20)
+
+// data of every block is aligned to it
+#define SQRL_ALLOCATOR_MIN_ALIGN word_s
+
+// blocks smaller than it are served by thread cache
+#define SQRL_ALLOCATOR_TCACHE_MAX_SIZE SQRL_BLOCK_SMALL_BIN_LIMIT
+// max number of blocks of one size kept by thread cache
+#define SQRL_ALLOCATOR_TCACHE_COUNT 32
+// number of blocks moved between thread cache and central heap at once
+#define SQRL_ALLOCATOR_TCACHE_BATCH 16
+// max number of blocks in remote free list of a thread cache, see ThreadCache
+#define SQRL_ALLOCATOR_TCACHE_REMOTE_COUNT 1024
+// max number of thread caches owning their blocks, later ones own none
+#define SQRL_ALLOCATOR_TCACHE_OWNER_NUM 256
+
+// hardened mode only, number of released blocks held back before they are
+// reused, a write to one of them is caught once it leaves
+#ifndef SQRL_ALLOCATOR_QUARANTINE_NUM
+#define SQRL_ALLOCATOR_QUARANTINE_NUM 0
+#endif
 
 namespace sqrl {
 
@@ -38,18 +70,123 @@ public:
   void next();
 };
 
+/*
+Free small blocks are kept in size class bins,
+a bitmap of non-empty bins makes looking up a fitting block O(1)
+
+All blocks belong to one central heap shared by all threads,
+hold mutex() for any operation on it
+*/
 class BlockManager {
 public:
   BlockManager() = default;
   ~BlockManager() = default;
+  std::mutex &mutex();
   void add_block(BlockAgent, bool);
   // free a block from given data
   void free_data(BlockData *);
   void split_block(BlockAgent, size_t);
   BlockAgent get_new_block(size_t);
+  /*
+  Released large mapping for a request below raised mmap threshold,
+  null if none holds it. Requests freeing and taking buffers of the same
+  size keep reusing one mapping.
+  */
+  BlockAgent get_cached_block(size_t);
+  // large block from os whose data is aligned to {alignment}
+  BlockAgent get_new_aligned_block(size_t size, size_t alignment);
+  /*
+  Grow or shrink a used small block in place to hold {size} bytes, by its
+  released next block or by the memory right after the top of the heap.
+  The rest goes to a bin. Return false and the block is left as it is.
+  */
+  bool resize_block(BlockAgent, size_t size);
+  // move a used large block by mremap to hold {size} bytes, null if it can't
+  BlockAgent remap_block(BlockAgent, size_t size);
+  // find a released block which is able to hold given block size
+  BlockAgent get_free_block(size_t);
+  /*
+  Cut the front of a released block off so that data of the rest is
+  aligned to {alignment}, the front goes to a bin.
+  Return the rest, still released.
+  */
+  BlockAgent align_block(BlockAgent, size_t alignment);
+  /*
+  Walk at most {steps} blocks from where last walk stops, merge released
+  neighbours and purge pages of released blocks not smaller than
+  {purge_size}. It stops early after one purge.
+  Return true once the walk reaches the end of the chain.
+  */
+  bool compact(size_t steps, size_t purge_size);
+  // size purged by compact
+  size_t purged_size();
+  // return released top of the heap back to os, keep {pad} bytes
+  size_t trim(size_t pad);
+  /*
+  Blocks at or above mmap threshold are mapped by mmap. Like glibc, it is
+  raised to the size of a large block released, up to
+  SQRL_ALLOCATOR_MMAP_THRESHOLD_MAX, unless it is set.
+  */
+  size_t mmap_threshold();
+  void set_mmap_threshold(size_t);
+  /*
+  Return released large mappings kept for reuse back to os, those left
+  idle through {max_age} calls before are kept, so all of them by default.
+  */
+  size_t release_mmap_cache(size_t max_age = 0);
+  /*
+  Blocks released while the heap is held by another thread are pushed to
+  a remote free list with one CAS, see GenericAllocator::deallocate.
+  The holder of mutex() frees them.
+  */
+  static void push_remote_free(BlockData *);
+  void free_remote();
+  /*
+  Release blocks held back in quarantine at once, each is checked as it
+  leaves. Nothing to do unless hardened with SQRL_ALLOCATOR_QUARANTINE_NUM.
+  */
+  void flush_quarantine();
   void clear();
 };
 
+enum class DumpFormat { text, json };
+
+/*
+AllocatorStats
+Snapshot of the heap, built from counters kept by the heap as it goes.
+Counts are indexed by size class of blocks, see size_class and
+size_class_min in block C module.
+*/
+struct AllocatorStats {
+  // used by users, blocks kept by thread caches are not
+  size_t used_size;
+  // highest used size so far, blocks kept by thread caches are included
+  size_t peak_used_size;
+  size_t requested_size;
+  // small blocks from arenas or sbrk, see set_block_backend
+  size_t heap_size;
+  // large blocks from mmap
+  size_t mmapped_size;
+  // part of mmapped size backed by huge pages, see set_huge_page
+  size_t huge_page_size;
+  // part of mmapped size released and kept for reuse
+  size_t mmap_cache_size;
+  size_t mmap_threshold;
+  size_t cached_size;
+  // released blocks in bins
+  size_t free_size;
+  size_t largest_free_size;
+  // share of free size not in the largest released block, 0 for none
+  double fragmentation;
+  size_t block_number;
+  size_t alloc_count[SQRL_BLOCK_BIN_NUM];
+  size_t free_count[SQRL_BLOCK_BIN_NUM];
+  // histogram of released blocks in bins
+  size_t free_block_count[SQRL_BLOCK_BIN_NUM];
+
+  std::string dump(DumpFormat format = DumpFormat::text) const;
+};
+
 /*
 Block Viewer
 Different from Allocator, Viewer does not participate in Block
@@ -65,11 +202,88 @@ public:
   size_t memory_requested_size();
 
   size_t block_number();
+  /*
+  A snapshot of the heap, blocks released by other threads and still
+  pending are freed first. Getters above leave the heap as it is.
+  */
+  AllocatorStats stats();
   BlockAgent get_head();
   BlockAgent get_top();
   bool safe_check();
 };
 
+/*
+Thread Cache
+Per thread magazines of small blocks in front of the central heap.
+Blocks are taken from and returned to central heap in batches, so that
+most of small allocations never touch shared state.
+
+Every thread cache owns the blocks it hands out, its id is kept in their
+header. A block released by another thread goes back to the remote free
+list of its owner with one CAS, and the owner takes the whole list with
+one exchange once a magazine is empty. So a producer and a consumer
+thread pass blocks around without any lock. Only a refill finding no
+block of the size there takes the central heap lock, once for a batch,
+as do blocks too large for a magazine.
+
+A remote free list full, or an owner of none, and the releasing thread
+keeps the block instead. A cached block is still used from central heap
+point of view.
+*/
+class ThreadCache {
+  friend class BlockManager;
+  friend class BlockViewer;
+
+public:
+  static ThreadCache &local();
+  // nullptr if given size is not served by thread cache
+  BlockData *allocate(size_t);
+  // false if given data is not served by thread cache
+  bool deallocate(BlockData *);
+  // return all cached blocks back to central heap
+  void flush();
+  // forget all cached blocks, only for BlockManager::clear
+  void reset();
+  size_t cached_size() const;
+  // cached size of all threads
+  static size_t total_cached_size();
+  // add counts of served blocks to given ones
+  void add_counts(size_t *alloc_count, size_t *free_count) const;
+  ~ThreadCache();
+
+private:
+  static const size_t bin_num =
+      SQRL_ALLOCATOR_TCACHE_MAX_SIZE / sizeof(word_t);
+  BlockManager manager;
+  Block *_bins[bin_num] = {};
+  size_t _counts[bin_num] = {};
+  // written by owner thread only, read by viewers of all threads
+  std::atomic<size_t> _cached_size{0};
+  std::atomic<size_t> _alloc_counts[bin_num] = {};
+  std::atomic<size_t> _free_counts[bin_num] = {};
+  bool _alive = true;
+  // id kept in blocks handed out, 0 if there is none left
+  size_t _owner = 0;
+  // chain of all thread caches
+  ThreadCache *_prev = nullptr;
+  ThreadCache *_next = nullptr;
+
+  ThreadCache();
+  void _refill(size_t, size_t);
+  void _flush(size_t, size_t);
+  // give a block released here back to its owner
+  static void _push_remote(size_t owner, Block *);
+  // take blocks released by other threads into magazines
+  void _take_remote();
+  // return blocks of a remote free list to central heap, under its lock
+  static void _free_remote_list(size_t owner);
+  // return blocks of all remote free lists to central heap
+  static void _flush_remote();
+  void _add_cached_size(size_t);
+  void _sub_cached_size(size_t);
+  static void _add_count(std::atomic<size_t> &);
+};
+
 /*
 Generaic Allocator will not consider object and its side,
 it will allocate exactly size user gives it.
@@ -80,11 +294,22 @@ private:
   BlockManager manager;
   BlockViewer viewer;
   BlockAgent find_free_block(size_t requested_size);
+  // resize without copying, nullptr if it can't
+  word_t *resize(word_t *data, size_t size);
 
 public:
   GenericAllocator() = default;
   // allocate given size of memory
   word_t *allocate(size_t);
+  // allocate given size of memory aligned to {alignment}, a power of two
+  word_t *allocate_aligned(size_t, size_t alignment);
+  /*
+  Resize given data to {size} bytes, like realloc. It grows in place by
+  released memory after it, large blocks are moved by mremap, otherwise
+  data is copied into a new block. Return nullptr and data is left as it
+  is if there is no memory.
+  */
+  word_t *reallocate(word_t *data, size_t size);
   // size is unused, for compatible with std API
   void deallocate(word_t *data, size_t);
   ~GenericAllocator() = default;
@@ -99,13 +324,52 @@ private:
   GenericAllocator impl;
 
 public:
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = ObjectAllocator<U>;
+  };
+  // all instances share the central heap
+  using propagate_on_container_move_assignment = std::true_type;
+
   ObjectAllocator() noexcept : impl(){};
+  template <typename U> ObjectAllocator(const ObjectAllocator<U> &) noexcept {}
   // allocator {size} of object T
   [[nodiscard("Memory leak")]] T *allocate(size_t size) {
+    // over-aligned type, e.g. cache line padded or SIMD vector
+    if constexpr (alignof(T) > SQRL_ALLOCATOR_MIN_ALIGN) {
+      return (T *)impl.allocate_aligned(size * sizeof(T), alignof(T));
+    }
     return (T *)impl.allocate(size * sizeof(T));
   }
+  // allocator {size} of object T aligned to {alignment}
+  [[nodiscard("Memory leak")]] T *allocate_aligned(size_t size,
+                                                   size_t alignment) {
+    return (T *)impl.allocate_aligned(size * sizeof(T), alignment);
+  }
+  /*
+  Resize {t} of {size} objects to {new_size} objects, objects are moved by
+  copying bytes so T must be trivially relocatable. Return nullptr and {t}
+  is left as it is if there is no memory.
+  */
+  [[nodiscard("Memory leak")]] T *reallocate(T *t, size_t size,
+                                             size_t new_size) {
+    static_assert(std::is_trivially_copyable_v<T> ||
+                      is_trivially_relocatable_v<T>,
+                  "objects are moved by copying bytes");
+    // a new block from reallocate may lose the alignment
+    if constexpr (alignof(T) > SQRL_ALLOCATOR_MIN_ALIGN) {
+      T *moved = allocate(new_size);
+      if (moved != nullptr) {
+        memcpy(moved, t, (size < new_size ? size : new_size) * sizeof(T));
+        deallocate(t, size);
+      }
+      return moved;
+    }
+    return (T *)impl.reallocate((word_t *)t, new_size * sizeof(T));
+  }
   // size is unused, for compatible with std API
   void deallocate(T *t, size_t size) { impl.deallocate((word_t *)t, size); }
+  bool operator==(const ObjectAllocator &) const { return true; }
   ~ObjectAllocator() noexcept = default;
 };
 
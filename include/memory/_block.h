@@ -8,6 +8,20 @@
 #define word_t intptr_t
 #define block_t struct Block
 #define block_header_t struct BlockHeader
+#define free_links_t struct FreeLinks
+
+/*
+Size classes of free blocks:
+- below SQRL_BLOCK_SMALL_BIN_LIMIT every word size has its own bin
+- above it every power of two is split into SQRL_BLOCK_BIN_SUB_NUM bins
+*/
+#define SQRL_BLOCK_SMALL_BIN_SHIFT 9
+#define SQRL_BLOCK_SMALL_BIN_LIMIT (1 << SQRL_BLOCK_SMALL_BIN_SHIFT)
+#define SQRL_BLOCK_SMALL_BIN_NUM (SQRL_BLOCK_SMALL_BIN_LIMIT / sizeof(word_t))
+#define SQRL_BLOCK_BIN_SUB_NUM 4
+#define SQRL_BLOCK_BIN_NUM                                                     \
+  (SQRL_BLOCK_SMALL_BIN_NUM +                                                  \
+   (64 - SQRL_BLOCK_SMALL_BIN_SHIFT) * SQRL_BLOCK_BIN_SUB_NUM)
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,11 +29,15 @@ extern "C" {
 const size_t word_s = sizeof(word_t);
 
 struct Block {
-  // due to the memory alignment, size cannot be 1
-  // the first bit is used for marking block is using or not
+  // due to the memory alignment, lowest bits of size are always 0
+  // they are used for flags, see SQRL_BLOCK_FLAGS
   // directly visit _size outside of block is not recommended
   size_t _size;
   struct Block *next;
+#ifdef SQRL_HARDENED
+  // see check_block
+  size_t canary;
+#endif
   /*
   basic payload of the block
   but not necessarily sizeof(data[1]) is the whole memory
@@ -31,8 +49,81 @@ struct Block {
 struct BlockHeader {
   size_t _size;
   struct Block *next;
+#ifdef SQRL_HARDENED
+  size_t canary;
+#endif
 };
 
+/*
+Links of a free block in its size class list,
+they live in the payload so a free block costs no extra memory
+*/
+struct FreeLinks {
+  struct Block *prev;
+  struct Block *next;
+};
+
+// smallest block which is able to carry FreeLinks and footer once released
+#define SQRL_BLOCK_MIN_SIZE                                                    \
+  (sizeof(block_header_t) + sizeof(free_links_t) + sizeof(size_t))
+
+// flags embedded in lowest bits of block size
+#define SQRL_BLOCK_USED 1
+// previous block in memory is released, its size is in its footer
+#define SQRL_BLOCK_PREV_FREE 2
+// block is requested by mmap and never joins the chain,
+// its next is where the mapping begins if it is not the block itself,
+// or the block itself if it is backed by huge pages
+#define SQRL_BLOCK_MMAPPED 4
+#define SQRL_BLOCK_FLAGS                                                       \
+  (SQRL_BLOCK_USED | SQRL_BLOCK_PREV_FREE | SQRL_BLOCK_MMAPPED)
+
+/*
+Highest bits of size keep the owner of a used block, the thread cache
+which handed it out, 0 for none. Sizes never reach them on 64 bit, there
+is no owner on 32 bit.
+*/
+#if SIZE_MAX > 0xffffffffu
+#define SQRL_BLOCK_OWNER_SHIFT 48
+#define SQRL_BLOCK_OWNER_MASK (~(size_t)0 << SQRL_BLOCK_OWNER_SHIFT)
+#else
+#define SQRL_BLOCK_OWNER_SHIFT 0
+#define SQRL_BLOCK_OWNER_MASK ((size_t)0)
+#endif
+// block released by another thread, on its way back to its owner
+#define SQRL_BLOCK_OWNER_REMOTE 0xffff
+
+/*
+Where small blocks come from:
+- SQRL_BLOCK_BACKEND_ARENA carves them out of arenas mapped by mmap,
+  one system call per SQRL_BLOCK_ARENA_SIZE bytes
+- SQRL_BLOCK_BACKEND_SBRK moves program break for every new block
+*/
+#define SQRL_BLOCK_BACKEND_ARENA 0
+#define SQRL_BLOCK_BACKEND_SBRK 1
+#ifndef SQRL_BLOCK_DEFAULT_BACKEND
+#define SQRL_BLOCK_DEFAULT_BACKEND SQRL_BLOCK_BACKEND_ARENA
+#endif
+#define SQRL_BLOCK_ARENA_SIZE (2 << 20)
+
+/*
+Large blocks of at least a huge page may be backed by huge pages once it
+is enabled, a random access over a large buffer misses TLB much less.
+MAP_HUGETLB is tried first, then madvise(MADV_HUGEPAGE) on a mapping
+aligned to a huge page. Such blocks are rounded up to huge pages.
+*/
+#define SQRL_BLOCK_HUGE_PAGE_SIZE (2 << 20)
+
+/*
+Hardened mode, built with SQRL_HARDENED:
+- every header carries a canary of its address and size, a header
+  overwritten by an overflow is caught when the block is checked
+- released payload is poisoned by SQRL_BLOCK_POISON
+- large blocks of plain pages lie between two guard pages, the block ends
+  right at the one after it
+*/
+#define SQRL_BLOCK_POISON 0xdb
+
 extern block_t *_block_head;
 extern block_t *_block_top;
 extern size_t _block_allocated;
@@ -41,22 +132,111 @@ size_t align(size_t);
 
 size_t alloc_size(size_t);
 
+// backend of request_block_from_os, blocks requested before stay valid
+void set_block_backend(int);
+
+int get_block_backend();
+
+// size of arenas mapped afterwards
+void set_arena_size(size_t);
+
+// for large blocks requested afterwards
+void set_huge_page(bool);
+
+bool get_huge_page();
+
+// large block is backed by huge pages, or transparent huge pages advised
+bool huge_page(block_t *);
+
+// where the next block from os begins
+void *heap_end();
+
 block_t *request_block_from_os(size_t);
 
 block_t *request_large_block_from_os(size_t);
 
+// data of the block is aligned to {alignment}, a power of two
+block_t *request_aligned_large_block_from_os(size_t size, size_t alignment);
+
 void release_block(block_t *block);
 
+void acquire_block(block_t *block);
+
+/*
+Grow or shrink a large block to hold {size} bytes by mremap, it may move.
+Blocks of huge pages or aligned ones not beginning their mapping can't.
+Return the block, or NULL and the block is left as it is.
+*/
+block_t *remap_large_block(block_t *block, size_t size);
+
 // 0 for successful completion, -1 for fail
 int release_large_block_to_os(block_t *block);
 
+// size returned back to os
+size_t release_top_to_os(block_t *block, size_t keep);
+
+// size returned back to os
+size_t purge_block(block_t *block);
+
+// canary of the header is intact, always true unless hardened
+bool check_block(block_t *);
+
+// report a corrupted heap around the block and abort
+void block_corrupted(block_t *, const char *reason);
+
+// fill payload of a released block beyond its free links and footer
+void poison_block(block_t *);
+
+// nothing is written to the poisoned payload since poison_block
+bool poisoned(block_t *);
+
 block_header_t *get_header(word_t *);
 
 block_t *get_block(word_t *);
 
 void split(block_t *, size_t);
 
-void coalesce_block(block_t *);
+block_t *split_at(block_t *, size_t offset);
+
+size_t aligned_offset(block_t *, size_t alignment);
+
+// true if block is merged with the next one
+bool coalesce_block(block_t *);
+
+/*
+Resize a used block in place, its data is kept:
+- shrink_block cuts the part beyond {size} bytes of data off, it becomes a
+  released block and is returned, NULL if it is too small to be a block
+- absorb_next_block merges the released block next to it into it
+- extend_top_block grows the block at heap_end to hold {size} bytes of
+  data by the memory right after it, return size requested from os,
+  0 if the heap can't grow there
+*/
+block_t *shrink_block(block_t *block, size_t size);
+
+bool absorb_next_block(block_t *block);
+
+size_t extend_top_block(block_t *block, size_t size);
+
+// next block in the chain is also next to it in memory
+bool adjacent(block_t *);
+
+void set_footer(block_t *);
+
+// previous block in memory if it is released
+block_t *get_prev_free(block_t *);
+
+// index of the free list a block of given size belongs to
+size_t size_class(size_t);
+
+// smallest block size of a size class
+size_t size_class_min(size_t index);
+
+free_links_t *get_free_links(block_t *);
+
+void free_list_push(block_t **, block_t *);
+
+void free_list_remove(block_t **, block_t *);
 
 void reset();
 
@@ -71,6 +251,21 @@ size_t get_size(block_t *);
 
 void set_size(block_t *, size_t);
 
+bool prev_free(block_t *);
+
+void prev_free_set(block_t *);
+
+void prev_free_clear(block_t *);
+
+bool mmapped(block_t *);
+
+size_t get_owner(block_t *);
+
+void set_owner(block_t *, size_t owner);
+
+// false and owner is left as it is unless it is {expected}
+bool replace_owner(block_t *, size_t expected, size_t owner);
+
 #ifdef __cplusplus
 }
 #endif
@@ -49,6 +49,64 @@ static_assert(AllocatorInterface<GenericAllocator, word_t>);
 
 template <typename T> using Allocator = ObjectAllocator<T>;
 
+template <typename...> using _alloc_void_t = void;
+
+// Alloc<T, Args...> to Alloc<U, Args...> if Alloc has no rebind of its own
+template <typename Alloc, typename U, typename = void>
+struct _alloc_rebind {};
+
+template <template <typename, typename...> class Alloc, typename T,
+          typename... Args, typename U>
+struct _alloc_rebind<Alloc<T, Args...>, U, void> {
+  using type = Alloc<U, Args...>;
+};
+
+template <typename Alloc, typename U>
+struct _alloc_rebind<Alloc, U,
+                     _alloc_void_t<typename Alloc::template rebind<U>::other>> {
+  using type = typename Alloc::template rebind<U>::other;
+};
+
+template <typename Alloc, typename = void>
+struct _alloc_propagate_on_move : false_type {};
+
+template <typename Alloc>
+struct _alloc_propagate_on_move<
+    Alloc, _alloc_void_t<typename Alloc::propagate_on_container_move_assignment>>
+    : integral_constant<
+          bool, Alloc::propagate_on_container_move_assignment::value> {};
+
+template <typename Alloc, typename = void>
+struct _alloc_can_reallocate : false_type {};
+
+template <typename Alloc>
+struct _alloc_can_reallocate<
+    Alloc, _alloc_void_t<decltype(std::declval<Alloc &>().reallocate(
+               nullptr, size_t{}, size_t{}))>> : true_type {};
+
+/*
+AllocatorTraits
+How containers treat a stateful allocator:
+- rebind<U> is the same allocator for another type, it is constructed from
+  the original one and shares its state
+- propagate_on_move tells whether a container moved into another one
+  takes its allocator along, otherwise elements are moved one by one into
+  memory of the target allocator
+- can_reallocate tells whether it has reallocate(data, size, new_size),
+  trivially copyable elements are moved by it, in place if possible
+*/
+template <typename Alloc> struct AllocatorTraits {
+  template <typename U> using rebind = typename _alloc_rebind<Alloc, U>::type;
+  static constexpr bool propagate_on_move =
+      _alloc_propagate_on_move<Alloc>::value;
+  static constexpr bool can_reallocate = _alloc_can_reallocate<Alloc>::value;
+};
+
+static_assert(AllocatorTraits<Allocator<int>>::propagate_on_move);
+static_assert(AllocatorTraits<Allocator<int>>::can_reallocate);
+static_assert(
+    is_same_v<AllocatorTraits<Allocator<int>>::rebind<char>, Allocator<char>>);
+
 }; // namespace sqrl
 
 #endif
\ No newline at end of file
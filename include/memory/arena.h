@@ -0,0 +1,109 @@
+#ifndef INCLUDED_ARENA_H
+#define INCLUDED_ARENA_H
+
+#include <cstddef>
+
+#include <memory/allocator.h>
+
+// size of chunks an arena requests from upstream allocator
+#define SQRL_ARENA_CHUNK_SIZE 65536
+
+namespace sqrl {
+
+/*
+MonotonicArena
+Bump allocator for objects sharing one lifetime:
+- allocate moves a cursor forward, deallocate does nothing
+- reset gives everything back at once in O(1), chunks are kept and reused
+- it starts from an optional buffer owned by caller, then chains chunks
+  requested from GenericAllocator
+
+It is not thread safe, each thread has its own one by local().
+*/
+class MonotonicArena {
+public:
+  MonotonicArena(size_t chunk_size = SQRL_ARENA_CHUNK_SIZE);
+  MonotonicArena(void *buffer, size_t size,
+                 size_t chunk_size = SQRL_ARENA_CHUNK_SIZE);
+  ~MonotonicArena();
+  // allocate given size of memory, aligned to std::max_align_t
+  word_t *allocate(size_t);
+  // aligned to {alignment} as well, a power of two
+  word_t *allocate_aligned(size_t, size_t alignment);
+  // memory is given back by reset only
+  void deallocate(word_t *, size_t) {}
+  // forget every allocation, keep chunks for later ones
+  void reset();
+  // give chunks back to upstream
+  void release();
+  // size handed out since last reset
+  size_t allocated_size() const;
+  // arena of current thread
+  static MonotonicArena &local();
+
+  MonotonicArena(const MonotonicArena &) = delete;
+  MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+private:
+  struct Chunk {
+    Chunk *next;
+    size_t size;
+  };
+  GenericAllocator upstream;
+  size_t chunk_size;
+  void *buffer;
+  size_t buffer_size;
+  // chain of chunks, current one is where cursor is
+  Chunk *head;
+  Chunk *current;
+  char *cursor;
+  char *end;
+  size_t allocated;
+  // move to next chunk able to hold {size} bytes aligned to {alignment}
+  bool next_chunk(size_t size, size_t alignment);
+};
+
+/*
+ArenaAllocator
+Typed view of a MonotonicArena, copies share the same arena.
+By default it is arena of current thread.
+*/
+template <typename T> class ArenaAllocator {
+private:
+  MonotonicArena *_arena;
+  template <typename U> friend class ArenaAllocator;
+
+public:
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = ArenaAllocator<U>;
+  };
+  using propagate_on_container_move_assignment = std::true_type;
+
+  ArenaAllocator() noexcept : _arena(&MonotonicArena::local()) {}
+  ArenaAllocator(MonotonicArena &arena) noexcept : _arena(&arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+      : _arena(other._arena) {}
+  // allocator {size} of object T
+  [[nodiscard("Memory leak")]] T *allocate(size_t size) {
+    return (T *)_arena->allocate_aligned(size * sizeof(T), alignof(T));
+  }
+  void deallocate(T *, size_t) {}
+  MonotonicArena &arena() const { return *_arena; }
+  bool operator==(const ArenaAllocator &other) const {
+    return _arena == other._arena;
+  }
+};
+
+#if __cplusplus < 202002L
+static_assert(AllocatorInterface<MonotonicArena, word_t>());
+static_assert(AllocatorInterface<ArenaAllocator<int>, int>());
+#elif __cplusplus >= 202002L
+static_assert(AllocatorInterface<MonotonicArena, word_t>);
+static_assert(AllocatorInterface<ArenaAllocator<int>, int>);
+#endif
+
+}; // namespace sqrl
+
+#endif
@@ -1,7 +1,12 @@
 #ifndef INCLUDED_MEMORY_DESTROY_H
 #define INCLUDED_MEMORY_DESTROY_H
 
+#include <cstring>
 #include <memory/_block.h>
+#include <metaprogramming/types.h>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace sqrl {
 
@@ -13,6 +18,34 @@ template <class T> void destroy_n(T *ptr, size_t n) {
   }
 }
 
+// construct {to} from {from} and destroy {from}, it is moved if that can't
+// throw or it can't be copied, otherwise copied
+template <class T> void relocate_at(T *to, T *from) {
+  static_assert(std::is_move_constructible_v<T> ||
+                    std::is_copy_constructible_v<T>,
+                "relocated objects must be move or copy constructible");
+  if constexpr (std::is_nothrow_move_constructible_v<T> ||
+                !std::is_copy_constructible_v<T>) {
+    new (to) T(std::move(*from));
+  } else {
+    new (to) T(*from);
+  }
+  destroy_at(from);
+}
+
+// relocate {n} objects to a space not overlapping them
+template <class T> void relocate_n(T *to, T *from, size_t n) {
+  if constexpr (is_trivially_relocatable_v<T>) {
+    if (n != 0) {
+      memcpy((void *)to, (const void *)from, n * sizeof(T));
+    }
+  } else {
+    for (size_t itr = 0; itr < n; itr++) {
+      relocate_at(to + itr, from + itr);
+    }
+  }
+}
+
 }; // namespace sqrl
 
 #endif
\ No newline at end of file
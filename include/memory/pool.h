@@ -0,0 +1,201 @@
+#ifndef INCLUDED_POOL_H
+#define INCLUDED_POOL_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+
+#include <memory/allocator.h>
+
+// number of objects in one slab by default
+#define SQRL_POOL_CHUNK_NUM 64
+#define SQRL_POOL_CACHE_LINE 64
+
+namespace sqrl {
+
+/*
+PoolAllocator
+Fixed size object pool for T:
+- slabs of {ChunkN} slots are carved from GenericAllocator, each one
+  starts at a cache line
+- a freed slot keeps the next free slot in itself, allocate and
+  deallocate of one object only push or pop the free list
+- allocation of many objects at once goes to GenericAllocator
+
+Copies share one pool and slabs go back once the last copy is destroyed,
+a pool rebound to another type is a new one. Copies may be made and
+destroyed on any thread, but slots are allocated and deallocated by one
+thread at a time.
+*/
+template <typename T, size_t ChunkN = SQRL_POOL_CHUNK_NUM>
+class PoolAllocator {
+private:
+  union Slot {
+    Slot *next;
+    alignas(T) char data[sizeof(T)];
+  };
+  struct Slab {
+    Slab *next;
+  };
+  struct Pool {
+    std::atomic<size_t> refs;
+    Slot *free;
+    // slots of the latest slab never handed out
+    Slot *bump;
+    Slot *bump_end;
+    Slab *slabs;
+  };
+  static constexpr size_t _slot_size = sizeof(Slot);
+  static constexpr size_t _slab_size =
+      sizeof(Slab) + SQRL_POOL_CACHE_LINE - 1 + _slot_size * ChunkN;
+
+  GenericAllocator _upstream;
+  // created by first allocation or copy, threads copying one allocator
+  // race to publish it
+  mutable std::atomic<Pool *> _pool{nullptr};
+
+  Pool *_get_pool() const {
+    Pool *pool = _pool.load(std::memory_order_acquire);
+    if (pool != nullptr) {
+      return pool;
+    }
+    Pool *created = new (GenericAllocator().allocate(sizeof(Pool)))
+        Pool{{1}, nullptr, nullptr, nullptr, nullptr};
+    if (!_pool.compare_exchange_strong(pool, created,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+      // another copy published one first
+      GenericAllocator().deallocate((word_t *)created, sizeof(Pool));
+      return pool;
+    }
+    return created;
+  }
+
+  void _release() {
+    Pool *pool = _pool.load(std::memory_order_relaxed);
+    if (pool == nullptr ||
+        pool->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    while (pool->slabs != nullptr) {
+      Slab *next = pool->slabs->next;
+      _upstream.deallocate((word_t *)pool->slabs, _slab_size);
+      pool->slabs = next;
+    }
+    _upstream.deallocate((word_t *)pool, sizeof(Pool));
+    _pool.store(nullptr, std::memory_order_relaxed);
+  }
+
+  Slot *_new_slab() {
+    Slab *slab = (Slab *)_upstream.allocate(_slab_size);
+    if (slab == nullptr) {
+      return nullptr;
+    }
+    Pool *pool = _pool.load(std::memory_order_relaxed);
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    uintptr_t begin = ((uintptr_t)(slab + 1) + SQRL_POOL_CACHE_LINE - 1) &
+                      ~(uintptr_t)(SQRL_POOL_CACHE_LINE - 1);
+    pool->bump = (Slot *)begin + 1;
+    pool->bump_end = (Slot *)begin + ChunkN;
+    return (Slot *)begin;
+  }
+
+  template <typename U, size_t N> friend class PoolAllocator;
+
+public:
+  static_assert(ChunkN > 0, "slab holds at least one object");
+  static_assert(alignof(T) <= SQRL_POOL_CACHE_LINE,
+                "object is aligned beyond a cache line");
+
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = PoolAllocator<U, ChunkN>;
+  };
+  using propagate_on_container_move_assignment = std::true_type;
+
+  PoolAllocator() noexcept = default;
+  PoolAllocator(const PoolAllocator &other) noexcept
+      : _pool(other._get_pool()) {
+    _pool.load(std::memory_order_relaxed)
+        ->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  PoolAllocator(PoolAllocator &&other) noexcept
+      : _pool(other._pool.exchange(nullptr, std::memory_order_relaxed)) {}
+  // slots of another type do not fit, start a new pool
+  template <typename U, size_t N>
+  PoolAllocator(const PoolAllocator<U, N> &) noexcept {}
+  PoolAllocator &operator=(const PoolAllocator &other) {
+    if (this != &other) {
+      Pool *pool = other._get_pool();
+      pool->refs.fetch_add(1, std::memory_order_relaxed);
+      _release();
+      _pool.store(pool, std::memory_order_relaxed);
+    }
+    return *this;
+  }
+  PoolAllocator &operator=(PoolAllocator &&other) {
+    if (this != &other) {
+      _release();
+      _pool.store(other._pool.exchange(nullptr, std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    }
+    return *this;
+  }
+
+  ~PoolAllocator() { _release(); }
+
+  // allocator {size} of object T
+  [[nodiscard("Memory leak")]] T *allocate(size_t size) {
+    if (size != 1) {
+      // over-aligned type, as ObjectAllocator does
+      if constexpr (alignof(T) > SQRL_ALLOCATOR_MIN_ALIGN) {
+        return (T *)_upstream.allocate_aligned(size * sizeof(T), alignof(T));
+      }
+      return (T *)_upstream.allocate(size * sizeof(T));
+    }
+    Pool *pool = _get_pool();
+    Slot *slot = pool->free;
+    if (slot != nullptr) {
+      pool->free = slot->next;
+    } else if (pool->bump != pool->bump_end) {
+      slot = pool->bump++;
+    } else {
+      slot = _new_slab();
+    }
+    return (T *)slot;
+  }
+
+  // {size} must be the same as in allocate
+  void deallocate(T *t, size_t size) {
+    if (size != 1) {
+      _upstream.deallocate((word_t *)t, size);
+      return;
+    }
+    Pool *pool = _pool.load(std::memory_order_relaxed);
+    // never allocated a slot, it is from another allocator
+    assert(pool != nullptr && "slot is not from this pool");
+    Slot *slot = (Slot *)t;
+    slot->next = pool->free;
+    pool->free = slot;
+  }
+
+  // copies share a pool, one with no pool yet equals only itself
+  bool operator==(const PoolAllocator &other) const {
+    Pool *pool = _pool.load(std::memory_order_acquire);
+    return this == &other ||
+           (pool != nullptr &&
+            pool == other._pool.load(std::memory_order_acquire));
+  }
+};
+
+#if __cplusplus < 202002L
+static_assert(AllocatorInterface<PoolAllocator<int>, int>());
+#elif __cplusplus >= 202002L
+static_assert(AllocatorInterface<PoolAllocator<int>, int>);
+#endif
+
+}; // namespace sqrl
+
+#endif
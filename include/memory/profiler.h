@@ -0,0 +1,56 @@
+#ifndef INCLUDED_PROFILER_H
+#define INCLUDED_PROFILER_H
+
+#include <atomic>
+#include <string>
+
+#include <memory/_allocator_impl.h>
+
+// one allocation is sampled once every given bytes allocated by a thread
+#define SQRL_PROFILER_SAMPLE_RATE (512 * 1024)
+// frames of call stack kept for an allocation site
+#define SQRL_PROFILER_DEPTH 8
+// max number of allocation sites and live sampled allocations
+#define SQRL_PROFILER_SITE_NUM 1024
+#define SQRL_PROFILER_LIVE_NUM 16384
+
+namespace sqrl {
+
+/*
+HeapProfiler
+Sampled allocation site profiler of GenericAllocator. Once started, an
+allocation is sampled every {sample_rate} bytes allocated by a thread and
+its call stack is kept as the site, with samples and sampled bytes:
+- in total since started
+- still live, sampled allocations not released yet
+
+Multiply samples by sample rate for an estimation of the whole heap.
+It costs nothing but one flag check when it is not started. Releases are
+tracked from start till reset, a stopped profile still sees sampled
+allocations go, and only those take its lock.
+*/
+class HeapProfiler {
+public:
+  // clear previous profile and start sampling
+  static void start(size_t sample_rate = SQRL_PROFILER_SAMPLE_RATE);
+  // profile is kept for dump
+  static void stop();
+  static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+  // releases are recorded, from start till reset
+  static bool tracking() { return _tracking.load(std::memory_order_relaxed); }
+  static void reset();
+  // sites with stack symbols, most live bytes first
+  static std::string dump(DumpFormat format = DumpFormat::text);
+
+  // hooks of GenericAllocator
+  static void record_allocate(word_t *data, size_t size);
+  static void record_deallocate(word_t *data);
+
+private:
+  static inline std::atomic<bool> _enabled{false};
+  static inline std::atomic<bool> _tracking{false};
+};
+
+}; // namespace sqrl
+
+#endif
@@ -1,15 +1,71 @@
 #ifndef INCLUDED_RECLAIMER_H
 #define INCLUDED_RECLAIMER_H
 
-#include <memory/_block.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include <memory/_allocator_impl.h>
+#include <thread/thread.h>
+
+// max number of blocks visited while holding the heap
+#define SQRL_RECLAIMER_STEP_SIZE 64
+// released blocks not smaller than it give their pages back to os
+#define SQRL_RECLAIMER_PURGE_SIZE 65536
+// released top of the heap kept when trimming
+#define SQRL_RECLAIMER_TOP_PAD 65536
+// passes a cached large mapping stays idle before it is unmapped
+#define SQRL_RECLAIMER_CACHE_AGE 1
 
 namespace sqrl {
 
+/*
+Reclaimer
+Give memory no longer used back to os. It walks the heap incrementally,
+each step holds the heap for at most {step_size} blocks and one purge:
+- merge released neighbours
+- purge pages of large released blocks by madvise
+- trim released top of the heap by negative sbrk once a pass finishes
+- unmap cached large mappings no allocation took for {cache_age} passes
+
+It runs on demand, or passes on its own thread every interval.
+*/
 class Reclaimer {
 public:
+  Reclaimer(size_t step_size = SQRL_RECLAIMER_STEP_SIZE,
+            size_t purge_size = SQRL_RECLAIMER_PURGE_SIZE,
+            size_t top_pad = SQRL_RECLAIMER_TOP_PAD,
+            size_t cache_age = SQRL_RECLAIMER_CACHE_AGE);
+  ~Reclaimer();
+  // one bounded step, true once a whole pass finishes
+  bool step();
+  // a whole pass on demand, cached blocks of current thread included
   void run();
+  // passes on a background thread
+  void start(std::chrono::milliseconds interval);
+  void stop();
+  // size given back to os by this reclaimer
+  size_t trimmed_size();
+  size_t purged_size();
+
+  Reclaimer(const Reclaimer &) = delete;
+  Reclaimer &operator=(const Reclaimer &) = delete;
+
+private:
+  BlockManager manager;
+  size_t step_size;
+  size_t purge_size;
+  size_t top_pad;
+  size_t cache_age;
+  std::atomic<size_t> trimmed;
+  std::atomic<size_t> purged;
+  sqrl::Thread *worker;
+  bool running;
+  std::mutex lock;
+  std::condition_variable condition;
 };
 
 }; // namespace sqrl
 
-#endif
\ No newline at end of file
+#endif
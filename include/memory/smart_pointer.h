@@ -2,7 +2,9 @@
 #define INCLUDED_SMART_POINTERS_H
 
 #include <memory/allocator.h>
+#include <memory/destroy.h>
 #include <metaprogramming/types.h>
+#include <utility>
 
 namespace sqrl {
 
@@ -18,13 +20,16 @@ public:
 template <class T, class Deleter = _default_deleter> class unique_ptr {
 private:
   T *ptr;
+  Deleter deleter;
 
 public:
   unique_ptr() : ptr(nullptr) {}
   explicit unique_ptr(T *_ptr) : ptr(_ptr) {}
+  // deleter may carry state, e.g. allocator the pointer comes from
+  unique_ptr(T *_ptr, const Deleter &_deleter) : ptr(_ptr), deleter(_deleter) {}
 
   unique_ptr(const unique_ptr &) = delete;
-  unique_ptr(unique_ptr &&other) {
+  unique_ptr(unique_ptr &&other) : deleter(std::move(other.deleter)) {
     ptr = other.ptr;
     if (this != &other) {
       other.ptr = nullptr;
@@ -34,6 +39,7 @@ public:
   unique_ptr &operator=(const unique_ptr &) = delete;
   unique_ptr &operator=(unique_ptr &&other) {
     ptr = other.ptr;
+    deleter = std::move(other.deleter);
     if (this != &other) {
       other.ptr = nullptr;
     }
@@ -49,7 +55,7 @@ public:
     if (is_null()) {
       return;
     }
-    Deleter::clean(ptr);
+    deleter.clean(ptr);
   }
 
   T *operator->() { return ptr; }
@@ -67,19 +73,23 @@ template <class T, class Deleter = _default_deleter> class shared_ptr {
 private:
   T *ptr;
   int *count;
+  Deleter deleter;
 
 public:
   shared_ptr() : ptr(nullptr), count(nullptr) {}
   explicit shared_ptr(T *_ptr) : ptr(_ptr), count(new int(1)) {}
+  // deleter may carry state, e.g. allocator the pointer comes from
+  shared_ptr(T *_ptr, const Deleter &_deleter)
+      : ptr(_ptr), count(new int(1)), deleter(_deleter) {}
 
-  shared_ptr(const shared_ptr &other) {
+  shared_ptr(const shared_ptr &other) : deleter(other.deleter) {
     count = other.count;
     ptr = other.ptr;
     if (this != &other) {
       (*count)++;
     }
   }
-  shared_ptr(shared_ptr &&other) {
+  shared_ptr(shared_ptr &&other) : deleter(std::move(other.deleter)) {
     if (this == &other) {
       return;
     }
@@ -104,6 +114,7 @@ public:
   shared_ptr &operator=(const shared_ptr &rhs) {
     count = rhs.count;
     ptr = rhs.ptr;
+    deleter = rhs.deleter;
     if (this != &rhs) {
       (*count)++;
     }
@@ -125,7 +136,7 @@ public:
       return;
     }
     delete count;
-    Deleter::clean(ptr);
+    deleter.clean(ptr);
   }
 
   inline void reset(T *_ptr) {
@@ -256,22 +267,39 @@ typename shared_t<T>::type make_shared(Args &&...args) {
   return shared_ptr<T>(init);
 }
 
-// TODO: implement alloc_unique & alloc_shared
-// to use sqrl::Allocator to allocate and delete
-struct _alloc_allocator {
-  template <class T> static T *allocate() {
-    sqrl::Allocator<T> local_allocator;
-    T *slot = local_allocator.allocate(sizeof(T));
-    return slot;
-  }
-};
-struct _alloc_deleter {
-  template <class T> static void clean(T *data) {
-    sqrl::Allocator<T> allocator;
+// to use sqrl::Allocator or any stateful allocator to allocate and delete,
+// the deleter keeps the allocator rebound to the object type, the same
+// instance allocates and deallocates so memory goes back to where it comes
+// from
+template <class Alloc = sqrl::Allocator<char>> struct _alloc_deleter {
+  Alloc allocator;
+  _alloc_deleter(const Alloc &alloc = Alloc()) : allocator(alloc) {}
+  template <class T> void clean(T *data) {
+    destroy_at(data);
     allocator.deallocate(data, 1);
   }
 };
 
+template <class T, class Alloc>
+using _alloc_deleter_t =
+    _alloc_deleter<typename AllocatorTraits<Alloc>::template rebind<T>>;
+
+template <class T, class Alloc, class... Args>
+unique_ptr<T, _alloc_deleter_t<T, Alloc>> alloc_unique(const Alloc &alloc,
+                                                       Args &&...args) {
+  _alloc_deleter_t<T, Alloc> deleter(alloc);
+  T *init = new (deleter.allocator.allocate(1)) T(std::forward<Args>(args)...);
+  return unique_ptr<T, _alloc_deleter_t<T, Alloc>>(init, deleter);
+}
+
+template <class T, class Alloc, class... Args>
+shared_ptr<T, _alloc_deleter_t<T, Alloc>> alloc_shared(const Alloc &alloc,
+                                                       Args &&...args) {
+  _alloc_deleter_t<T, Alloc> deleter(alloc);
+  T *init = new (deleter.allocator.allocate(1)) T(std::forward<Args>(args)...);
+  return shared_ptr<T, _alloc_deleter_t<T, Alloc>>(init, deleter);
+}
+
 }; // namespace sqrl
 
 #endif
\ No newline at end of file
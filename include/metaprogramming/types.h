@@ -154,6 +154,17 @@ struct is_nothrow_constructible
     : public std::integral_constant<bool,
                                     noexcept(Fp(std::declval<Args>()...))> {};
 
+// is_trivially_relocatable <T> an object moved to another address by memcpy
+// is still valid and the old copy needs no destructor. Trivially copyable
+// types are, specialize it for others without pointers into themselves
+template <typename T>
+struct is_trivially_relocatable
+    : integral_constant<bool, std::is_trivially_copyable<T>::value> {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v =
+    is_trivially_relocatable<T>::value;
+
 // type_identity
 // is used to disable type deduction to require user to explicitly specify
 // type for template
@@ -2,6 +2,9 @@
 #define INCLUDED_STRING_H
 
 #include <memory/allocator.h>
+#include <metaprogramming/types.h>
+#include <utility>
+
 namespace sqrl {
 
 void _strcpy(char *, const char *);
@@ -9,27 +12,112 @@ unsigned int _strlen(const char *);
 bool _strcmp(const char *, const char *);
 bool _strncmp(const char *, const char *, size_t);
 
-class String {
+template <typename Alloc = sqrl::Allocator<char>> class BasicString {
 public:
-  String(const char *);
-  ~String();
-  String(const String &);
-  String(String &&);
-  String &operator=(const String &);
-  String &operator=(String &&);
-  String operator+(const String &);
-  bool operator==(const String &) const;
-  const char *c_str();
-  size_t size();
+  BasicString(const char *str, const Alloc &alloc = Alloc())
+      : allocator(alloc) {
+    if (str == nullptr) {
+      s_data = allocate(1);
+      s_len = 0;
+      *s_data = '\0';
+    } else {
+      s_len = _strlen(str);
+      s_data = allocate(s_len + 1);
+      _strcpy(s_data, str);
+    }
+  }
+
+  ~BasicString() { deallocate(s_data, s_len); }
+
+  BasicString(const BasicString &other) : allocator(other.allocator) {
+    s_data = allocate(other.s_len + 1);
+    _strcpy(s_data, other.s_data);
+    s_len = other.s_len;
+  }
+
+  // take over memory together with its allocator
+  BasicString(BasicString &&other) noexcept
+      : allocator(std::move(other.allocator)) {
+    s_data = other.s_data;
+    s_len = other.s_len;
+    other.s_data = nullptr;
+    other.s_len = 0;
+  }
+
+  BasicString &operator=(const BasicString &other) {
+    if (this == &other) {
+      return *this;
+    }
+    deallocate(s_data, s_len);
+    s_data = allocate(other.s_len + 1);
+    _strcpy(s_data, other.s_data);
+    s_len = other.s_len;
+    return *this;
+  }
+
+  BasicString &operator=(BasicString &&other) {
+    if (this == &other) {
+      return *this;
+    }
+    if constexpr (!AllocatorTraits<Alloc>::propagate_on_move) {
+      // memory of other belongs to its allocator
+      return *this = other;
+    }
+    deallocate(s_data, s_len);
+    allocator = std::move(other.allocator);
+    s_data = other.s_data;
+    s_len = other.s_len;
+    other.s_data = nullptr;
+    other.s_len = 0;
+    return *this;
+  }
+
+  BasicString operator+(const BasicString &other) {
+    BasicString result(nullptr, allocator);
+    result.deallocate(result.s_data, result.s_len);
+    result.s_len = s_len + other.s_len;
+    result.s_data = result.allocate(result.s_len + 1);
+    _strcpy(result.s_data, s_data);
+    _strcpy(result.s_data + s_len, other.s_data);
+    return result;
+  }
+
+  bool operator==(const BasicString &other) const {
+    if (s_len != other.s_len) {
+      return false;
+    }
+    return _strncmp(s_data, other.s_data, s_len);
+  }
+
+  const char *c_str() { return s_data; }
+
+  size_t size() { return s_len; }
+
+  Alloc get_allocator() const { return allocator; }
 
 private:
   char *s_data;
   size_t s_len;
-  sqrl::Allocator<char> allocator;
-  char *allocate(size_t);
-  void deallocate(char *);
+  Alloc allocator;
+
+  char *allocate(size_t size) { return allocator.allocate(size); }
+
+  // {len} is length of the string held by {data}
+  void deallocate(char *data, size_t len) {
+    if (data == nullptr) {
+      return;
+    }
+    allocator.deallocate(data, len + 1);
+  }
 };
 
+using String = BasicString<>;
+
+// nothing points into a string itself, its allocator decides
+template <typename Alloc>
+struct is_trivially_relocatable<BasicString<Alloc>>
+    : is_trivially_relocatable<Alloc> {};
+
 }; // namespace sqrl
 
-#endif
\ No newline at end of file
+#endif
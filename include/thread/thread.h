@@ -3,7 +3,10 @@
 
 #include <pthread.h>
 
+#include <memory>
+
 #include <memory/allocator.h>
+#include <memory/destroy.h>
 #include <metaprogramming/tuple.h>
 
 namespace sqrl {
@@ -17,37 +20,50 @@ private:
   bool joined;
 
 public:
-  template <typename Callable, typename... Args>
+  template <typename Callable, typename... Args,
+            typename = typename enable_if<!is_same_v<
+                typename decay<Callable>::type, std::allocator_arg_t>>::type>
   explicit ThreadImpl(Callable &&fp, Args &&...args) noexcept
+      : ThreadImpl(std::allocator_arg, sqrl::Allocator<char>(),
+                   std::forward<Callable>(fp), std::forward<Args>(args)...) {}
+
+  // function pack lives in memory from given allocator
+  template <typename Alloc, typename Callable, typename... Args>
+  ThreadImpl(std::allocator_arg_t, const Alloc &alloc, Callable &&fp,
+             Args &&...args) noexcept
       : worker(), joined(false) {
     typedef sqrl::Tuple<Callable, Args...> fp_pack_t;
+    // the pack carries its allocator to release itself on the new thread
+    struct Pack {
+      typename AllocatorTraits<Alloc>::template rebind<Pack> allocator;
+      fp_pack_t fp_pack;
+    };
+    typedef typename AllocatorTraits<Alloc>::template rebind<Pack> pack_alloc_t;
 
     struct Helper {
       static void *executor(void *args) {
-        // local allocator
-        static sqrl::Allocator<char> allocator;
-        fp_pack_t *fp_pack = static_cast<fp_pack_t *>(args);
-        sqrl::apply(*fp_pack);
+        Pack *pack = static_cast<Pack *>(args);
+        sqrl::apply(pack->fp_pack);
         // clean function pack after executing it
-        allocator.deallocate((char *)args, sizeof(fp_pack));
+        pack_alloc_t allocator(std::move(pack->allocator));
+        destroy_at(pack);
+        allocator.deallocate(pack, 1);
         // ignore return value
         return NULL;
       }
     }; // internal Helper
 
-    // memory leak mitigation
-    sqrl::Allocator<char> allocator;
-    size_t pack_size = sizeof(fp_pack_t);
-    char *pack_block = allocator.allocate(pack_size);
-    fp_pack_t *memory_block = reinterpret_cast<fp_pack_t *>(pack_block);
-    fp_pack_t *fp_pack = new (memory_block)
-        fp_pack_t(std::forward<Callable>(fp), std::forward<Args>(args)...);
+    pack_alloc_t allocator(alloc);
+    Pack *pack = new (allocator.allocate(1))
+        Pack{allocator, fp_pack_t(std::forward<Callable>(fp),
+                                  std::forward<Args>(args)...)};
 
     // error handling
     [[maybe_unused]] int succeed = pthread_create(
-        &worker, NULL, Helper::executor, reinterpret_cast<void *>(fp_pack));
+        &worker, NULL, Helper::executor, reinterpret_cast<void *>(pack));
     if (succeed != 0) {
-      allocator.deallocate(pack_block, pack_size);
+      destroy_at(pack);
+      allocator.deallocate(pack, 1);
       created = false;
     } else {
       created = true;
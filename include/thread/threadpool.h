@@ -1,12 +1,13 @@
 #ifndef INCLUDED_THREADPOOL_H
 #define INCLUDED_THREADPOOL_H
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 #include <utility>
 
 #include <async/future.h>
-#include <container/queue.h>
 #include <container/vector.h>
 #include <functional/function.h>
 #include <metaprogramming/types.h>
@@ -14,17 +15,37 @@
 
 namespace sqrl {
 
+/*
+ThreadPool
+Work stealing scheduler, every worker has
+- a Chase-Lev deque, tasks enqueued by a task running on the worker are
+  pushed to it and popped latest first
+- an inbox, tasks enqueued from outside the pool are dealt round robin
+  to inboxes of workers
+An idle worker steals the oldest task from the deque of a random worker,
+or takes a batch from its inbox. Workers with nothing to steal park till
+a task is enqueued.
+
+A task waiting for another one should await it, which runs other tasks
+meanwhile, instead of Future::get blocking its worker.
+*/
 class ThreadPool {
 public:
+  // a size below one is taken as one
   ThreadPool(int pool_size = 3);
+  ~ThreadPool();
   typedef sqrl::Function<void()> Task;
   void start();
+  // all tasks enqueued are done once it returns
   void stop();
 
   template <class T, class... Args>
   auto enqueue(T &&t, Args &&...args)
       -> sqrl::Future<typename sqrl::result_of<T(Args...)>::type>;
 
+  // run tasks of the pool till {future} is ready, then get it
+  template <class T> T await(sqrl::Future<T> &future);
+
   // remove copy methods
   ThreadPool(const ThreadPool &) = delete;
   const ThreadPool &operator=(const ThreadPool &) = delete;
@@ -34,15 +55,33 @@ public:
   inline int get_pool_size() { return pool_size; }
 
 private:
-  typedef sqrl::Vector<sqrl::Thread *> Threads;
-  Threads workers;
-  sqrl::Queue<Task> tasks;
+  struct Worker;
+  // pools are small, workers stay inside the pool
+  typedef sqrl::SmallVector<Worker *, 8> Workers;
+  Workers workers;
+  // parking of idle workers
   std::mutex lock;
   std::condition_variable condition;
-  bool begin;
-  int handled_tasks_num;
+  std::atomic<bool> begin;
+  std::atomic<int> handled_tasks_num;
   int pool_size;
+  // inbox of next task from outside
+  std::atomic<size_t> next_inbox;
+  // tasks enqueued so far, a parked worker wakes up once it changes
+  std::atomic<size_t> signals;
+  std::atomic<int> sleeping;
+
+  // worker of the pool running on this thread if any
+  static thread_local Worker *current;
+
+  void submit(Task &&task);
+  // run one task of the pool if there is any
+  bool run_one(Worker *self);
+  // take tasks from inbox of {victim}, run the first one and keep the rest
+  Task *take_inbox(Worker *victim, Worker *self);
+  void work(Worker *self);
 };
+
 template <class T, class... Args>
 auto ThreadPool::enqueue(T &&t, Args &&...args)
     -> sqrl::Future<typename sqrl::result_of<T(Args...)>::type> {
@@ -51,14 +90,20 @@ auto ThreadPool::enqueue(T &&t, Args &&...args)
   auto task = std::make_shared<sqrl::PackageTask<return_type()>>(
       std::bind(std::forward<T>(t), std::forward<Args>(args)...));
   sqrl::Future<return_type> result = task->get_future();
-  {
-    std::unique_lock<std::mutex> guard(lock);
-    tasks.emplace([task]() { (*task)(); });
-  }
-  condition.notify_one();
+  submit([task]() { (*task)(); });
   return result;
 }
 
+template <class T> T ThreadPool::await(sqrl::Future<T> &future) {
+  while (!future.ready()) {
+    if (!run_one(current)) {
+      // the task is running somewhere else
+      std::this_thread::yield();
+    }
+  }
+  return future.get();
+}
+
 }; // namespace sqrl
 
-#endif
\ No newline at end of file
+#endif
@@ -1,4 +1,7 @@
 #include <memory/_allocator_impl.h>
+#include <memory/profiler.h>
+
+#include <cstdio>
 
 namespace sqrl {
 
@@ -9,6 +12,212 @@ Block *_block_top = nullptr;
 static size_t _memory_used_size = 0;
 static size_t _memory_requested_size = 0;
 
+// central heap lock and chain of all thread caches it guards
+static std::mutex _heap_mutex;
+static ThreadCache *_thread_caches = nullptr;
+
+// where BlockManager::compact stops last time
+static Block *_compact_cursor = nullptr;
+static size_t _memory_purged_size = 0;
+
+// counters of BlockViewer::stats, guarded by central heap lock
+static size_t _memory_used_peak = 0;
+static size_t _memory_mmapped_size = 0;
+static size_t _memory_huge_page_size = 0;
+static size_t _memory_free_size = 0;
+static size_t _block_count = 0;
+// counts of blocks served by central heap and exited thread caches
+static size_t _heap_alloc_counts[SQRL_BLOCK_BIN_NUM] = {};
+static size_t _heap_free_counts[SQRL_BLOCK_BIN_NUM] = {};
+static size_t _bin_counts[SQRL_BLOCK_BIN_NUM] = {};
+
+// released large mappings kept for reuse, oldest first
+static Block *_mmap_cache[SQRL_ALLOCATOR_MMAP_CACHE_NUM] = {};
+// release passes each cached block has stayed idle, see release_mmap_cache
+static size_t _mmap_cache_ages[SQRL_ALLOCATOR_MMAP_CACHE_NUM] = {};
+static size_t _mmap_cache_number = 0;
+static size_t _mmap_cache_size = 0;
+static size_t _mmap_threshold = SQRL_ALLOCATOR_MMAP_THRESHOLD;
+static bool _mmap_threshold_fixed = false;
+
+// remote free lists of thread caches by owner id, see ThreadCache
+static const size_t _remote_list_num = SQRL_ALLOCATOR_TCACHE_OWNER_NUM + 1;
+static std::atomic<Block *> _remote_lists[_remote_list_num] = {};
+static std::atomic<size_t> _remote_counts[_remote_list_num] = {};
+static std::atomic<size_t> _remote_size{0};
+// ids taken by thread caches alive
+static bool _owners[_remote_list_num] = {};
+// blocks released while central heap is held, see BlockManager
+static std::atomic<Block *> _remote_frees{nullptr};
+static std::atomic<size_t> _remote_free_size{0};
+
+#if defined(SQRL_HARDENED) && SQRL_ALLOCATOR_QUARANTINE_NUM > 0
+// released blocks held back, a ring of the latest ones
+static std::mutex _quarantine_mutex;
+static BlockData *_quarantine[SQRL_ALLOCATOR_QUARANTINE_NUM] = {};
+static size_t _quarantine_begin = 0;
+static size_t _quarantine_number = 0;
+// still used from heap point of view, released from user's
+static std::atomic<size_t> _quarantine_size{0};
+#endif
+
+static size_t _quarantined_size() {
+#if defined(SQRL_HARDENED) && SQRL_ALLOCATOR_QUARANTINE_NUM > 0
+  return _quarantine_size.load(std::memory_order_relaxed);
+#else
+  return 0;
+#endif
+}
+
+// size class bins of released small blocks
+static const size_t _bin_map_num = (SQRL_BLOCK_BIN_NUM + 63) / 64;
+static Block *_bins[SQRL_BLOCK_BIN_NUM] = {};
+static uint64_t _bin_map[_bin_map_num] = {};
+
+static void _bin_insert(Block *block) {
+  size_t index = size_class(get_size(block));
+  free_list_push(&_bins[index], block);
+  _bin_map[index / 64] |= 1ULL << (index % 64);
+  _bin_counts[index]++;
+  _memory_free_size += get_size(block);
+}
+
+static void _bin_remove(Block *block) {
+  size_t index = size_class(get_size(block));
+  free_list_remove(&_bins[index], block);
+  _bin_counts[index]--;
+  _memory_free_size -= get_size(block);
+  if (_bins[index] == nullptr) {
+    _bin_map[index / 64] &= ~(1ULL << (index % 64));
+  }
+}
+
+static void _unmap(Block *block) {
+  _memory_requested_size -= get_size(block);
+  _memory_mmapped_size -= get_size(block);
+  if (huge_page(block)) {
+    _memory_huge_page_size -= get_size(block);
+  }
+  release_large_block_to_os(block);
+}
+
+static void _mmap_cache_remove(size_t index) {
+  _mmap_cache_size -= get_size(_mmap_cache[index]);
+  for (size_t i = index + 1; i < _mmap_cache_number; i++) {
+    _mmap_cache[i - 1] = _mmap_cache[i];
+    _mmap_cache_ages[i - 1] = _mmap_cache_ages[i];
+  }
+  _mmap_cache_number--;
+}
+
+/*
+Keep a released large block for reuse, the oldest ones are unmapped to
+make room. New blocks below mmap threshold come from the heap, but a
+mapping released before still serves requests of its size, see
+BlockManager::get_cached_block. Those below the threshold it starts
+from are unmapped.
+*/
+static void _mmap_cache_put(Block *block) {
+  size_t size = get_size(block);
+  // huge pages are asked for on purpose, blocks of them stay mapped
+  if (!_mmap_threshold_fixed && !huge_page(block) &&
+      size >= _mmap_threshold && size < SQRL_ALLOCATOR_MMAP_THRESHOLD_MAX) {
+    // new blocks of this size come from the heap afterwards
+    _mmap_threshold = size + 1;
+  }
+  size_t threshold =
+      _mmap_threshold_fixed ? _mmap_threshold : SQRL_ALLOCATOR_MMAP_THRESHOLD;
+  // only a mapping beginning at the block can be remapped later
+  if (block->next != nullptr || size < threshold ||
+      size > SQRL_ALLOCATOR_MMAP_CACHE_SIZE) {
+    _unmap(block);
+    return;
+  }
+  while (_mmap_cache_number == SQRL_ALLOCATOR_MMAP_CACHE_NUM ||
+         _mmap_cache_size + size > SQRL_ALLOCATOR_MMAP_CACHE_SIZE) {
+    Block *oldest = _mmap_cache[0];
+    _mmap_cache_remove(0);
+    _unmap(oldest);
+  }
+  _mmap_cache_ages[_mmap_cache_number] = 0;
+  _mmap_cache[_mmap_cache_number++] = block;
+  _mmap_cache_size += size;
+}
+
+/*
+Take a cached block for {size} bytes of block, the smallest one holding
+it, otherwise the largest one grown by mremap unless {grow} is false.
+One more than twice as large is shrunk, its tail is not worth keeping.
+*/
+static Block *_mmap_cache_get(size_t size, bool grow = true) {
+  size_t best = _mmap_cache_number;
+  for (size_t i = 0; i < _mmap_cache_number; i++) {
+    if (best == _mmap_cache_number) {
+      best = i;
+      continue;
+    }
+    size_t cached = get_size(_mmap_cache[i]);
+    size_t current = get_size(_mmap_cache[best]);
+    bool fits = cached >= size;
+    bool best_fits = current >= size;
+    if (fits ? !best_fits || cached < current
+             : !best_fits && cached > current) {
+      best = i;
+    }
+  }
+  if (best == _mmap_cache_number ||
+      (!grow && get_size(_mmap_cache[best]) < size)) {
+    return nullptr;
+  }
+  Block *block = _mmap_cache[best];
+  size_t cached = get_size(block);
+  _mmap_cache_remove(best);
+  if (cached >= size && cached <= 2 * size) {
+    return block;
+  }
+  Block *remapped = remap_large_block(block, size - sizeof(BlockHeader));
+  if (remapped == nullptr) {
+    _unmap(block);
+    return nullptr;
+  }
+  _memory_requested_size += get_size(remapped) - cached;
+  _memory_mmapped_size += get_size(remapped) - cached;
+  return remapped;
+}
+
+// merge released next block which is not in a bin into given block
+static void _absorb_next(Block *block) {
+  Block *next = block->next;
+  if (coalesce_block(block)) {
+    _block_count--;
+  }
+  if (_compact_cursor == next) {
+    _compact_cursor = block;
+  }
+}
+
+// merge released next block into given block which is not in a bin
+static void _merge_next(Block *block) {
+  _bin_remove(block->next);
+  _absorb_next(block);
+}
+
+// first non-empty bin starting from given index, SQRL_BLOCK_BIN_NUM if none
+static size_t _bin_next(size_t index) {
+  if (index >= SQRL_BLOCK_BIN_NUM) {
+    return SQRL_BLOCK_BIN_NUM;
+  }
+  size_t word = index / 64;
+  uint64_t bits = _bin_map[word] & (~0ULL << (index % 64));
+  while (bits == 0) {
+    if (++word == _bin_map_num) {
+      return SQRL_BLOCK_BIN_NUM;
+    }
+    bits = _bin_map[word];
+  }
+  return word * 64 + __builtin_ctzll(bits);
+}
+
 BlockAgent::BlockAgent(Block *block) : _block(block) {}
 BlockAgent::BlockAgent(BlockAgent &&other) {
   _block = other._block;
@@ -42,12 +251,14 @@ BlockData *BlockAgent::get_data() { return _block->data; }
 bool BlockAgent::null() const { return _block == nullptr; }
 void BlockAgent::next() { _block = _block->next; }
 
+std::mutex &BlockManager::mutex() { return _heap_mutex; }
+
 // mark block used and add to chain if the block is not there yet.
 void BlockManager::add_block(BlockAgent agent, bool is_new) {
   auto block = agent._block;
   // for small block add to linkedlist for reuse
   // for large block don't, see once release it will be returned back to os
-  if (agent._block->_size < SQRL_ALLOCATOR_MMAP_THRESHOLD) {
+  if (!mmapped(block)) {
     if (is_new) {
       block->next = nullptr;
       if (_block_head == nullptr) {
@@ -56,42 +267,328 @@ void BlockManager::add_block(BlockAgent agent, bool is_new) {
       // Chain the blocks
       if (_block_top != nullptr) {
         _block_top->next = block;
+        // released top merges with the block once it is released
+        if (!used(_block_top) && adjacent(_block_top)) {
+          prev_free_set(block);
+        }
       }
       _block_top = block;
+      _block_count++;
+    } else {
+      _bin_remove(block);
     }
   }
   _memory_used_size += agent.size();
-  agent.set_used(true);
+  if (_memory_used_size > _memory_used_peak) {
+    _memory_used_peak = _memory_used_size;
+  }
+  acquire_block(block);
 }
 
 void BlockManager::free_data(BlockData *data) {
-  BlockHeader *header = (BlockHeader *)get_header(data);
-  if (header->_size < SQRL_ALLOCATOR_MMAP_THRESHOLD) {
-    if (used((Block *)header)) {
-      _memory_used_size -= get_size((Block *)header);
-    }
-    release_block(get_block(data));
-  } else {
-    _memory_used_size -= get_size((Block *)header);
-    _memory_requested_size -= get_size((Block *)header);
-    release_large_block_to_os(get_block(data));
+  Block *block = get_block(data);
+  // released twice, it is in a bin or the mmap cache already
+  if (!used(block)) {
+#ifdef SQRL_HARDENED
+    block_corrupted(block, "double free");
+#endif
+    return;
+  }
+  // back to central heap, it has no owner here
+  if (get_owner(block) != 0) {
+    set_owner(block, 0);
+  }
+  if (mmapped(block)) {
+    _memory_used_size -= get_size(block);
+    // marked used again once taken out of the cache, see add_block
+    used_clear(block);
+    _mmap_cache_put(block);
+    return;
   }
+  _memory_used_size -= get_size(block);
+  release_block(block);
+  // merge with released neighbours, boundary tags find both in O(1)
+  if (adjacent(block) && !used(block->next)) {
+    _merge_next(block);
+  }
+  Block *prev = get_prev_free(block);
+  if (prev != nullptr) {
+    _bin_remove(prev);
+    _absorb_next(prev);
+    block = prev;
+  }
+  if (block->next == nullptr) {
+    _block_top = block;
+  }
+  _bin_insert(block);
 }
 
 BlockAgent BlockManager::get_new_block(size_t size) {
   Block *block;
-  if (size < SQRL_ALLOCATOR_MMAP_THRESHOLD) {
+  // decide by block size, free_data tells small from large blocks by it
+  if (alloc_size(size) < _mmap_threshold) {
     block = request_block_from_os(size);
   } else {
+    // cached blocks are of plain pages
+    if (!get_huge_page() || alloc_size(size) < SQRL_BLOCK_HUGE_PAGE_SIZE) {
+      block = _mmap_cache_get(alloc_size(size));
+      if (block != nullptr) {
+        return BlockAgent(block);
+      }
+    }
     block = request_large_block_from_os(size);
+    if (block == nullptr) {
+      return BlockAgent();
+    }
+    // it may be rounded up to huge pages
+    _memory_mmapped_size += get_size(block);
+    if (huge_page(block)) {
+      _memory_huge_page_size += get_size(block);
+    }
+    _memory_requested_size += get_size(block);
+    return BlockAgent(block);
   }
   _memory_requested_size += alloc_size(size);
   return BlockAgent(block);
 }
 
+BlockAgent BlockManager::get_cached_block(size_t size) {
+  // at or above mmap threshold it is taken by get_new_block
+  if (alloc_size(size) < SQRL_ALLOCATOR_MMAP_THRESHOLD ||
+      alloc_size(size) >= _mmap_threshold) {
+    return BlockAgent();
+  }
+  if (get_huge_page() && alloc_size(size) >= SQRL_BLOCK_HUGE_PAGE_SIZE) {
+    return BlockAgent();
+  }
+  return BlockAgent(_mmap_cache_get(alloc_size(size), false));
+}
+
+BlockAgent BlockManager::get_new_aligned_block(size_t size, size_t alignment) {
+  Block *block = request_aligned_large_block_from_os(size, alignment);
+  if (block == nullptr) {
+    return BlockAgent();
+  }
+  _memory_requested_size += get_size(block);
+  _memory_mmapped_size += get_size(block);
+  return BlockAgent(block);
+}
+
+bool BlockManager::resize_block(BlockAgent agent, size_t size) {
+  Block *block = agent._block;
+  size_t old_size = get_size(block);
+  bool resized = true;
+  if (alloc_size(size) > old_size) {
+    Block *next = block->next;
+    bool next_free = adjacent(block) && !used(next);
+    size_t room = next_free ? old_size + get_size(next) : old_size;
+    // only the top grows beyond its released next block
+    Block *top = next_free ? next : block;
+    if (room < alloc_size(size) && top != _block_top) {
+      return false;
+    }
+    if (next_free) {
+      _bin_remove(next);
+      absorb_next_block(block);
+      _block_count--;
+      if (_compact_cursor == next) {
+        _compact_cursor = block;
+      }
+      if (_block_top == next) {
+        _block_top = block;
+      }
+    }
+    if (get_size(block) < alloc_size(size)) {
+      size_t grown = extend_top_block(block, size);
+      _memory_requested_size += grown;
+      if (grown == 0) {
+        // give the released next block back
+        size = old_size - sizeof(BlockHeader);
+        resized = false;
+      }
+    }
+  }
+  Block *rest = shrink_block(block, size);
+  if (rest != nullptr) {
+    _block_count++;
+    if (_block_top == block) {
+      _block_top = rest;
+    }
+    if (adjacent(rest) && !used(rest->next)) {
+      _merge_next(rest);
+      if (rest->next == nullptr) {
+        _block_top = rest;
+      }
+    }
+    _bin_insert(rest);
+  }
+  _memory_used_size = _memory_used_size - old_size + get_size(block);
+  if (_memory_used_size > _memory_used_peak) {
+    _memory_used_peak = _memory_used_size;
+  }
+  return resized;
+}
+
+BlockAgent BlockManager::remap_block(BlockAgent agent, size_t size) {
+  Block *block = agent._block;
+  size_t old_size = get_size(block);
+  Block *moved = remap_large_block(block, size);
+  if (moved == nullptr) {
+    return BlockAgent();
+  }
+  _memory_used_size = _memory_used_size - old_size + get_size(moved);
+  _memory_requested_size = _memory_requested_size - old_size + get_size(moved);
+  _memory_mmapped_size = _memory_mmapped_size - old_size + get_size(moved);
+  if (_memory_used_size > _memory_used_peak) {
+    _memory_used_peak = _memory_used_size;
+  }
+  return BlockAgent(moved);
+}
+
+BlockAgent BlockManager::get_free_block(size_t size) {
+  size_t index = size_class(size);
+  if (index >= SQRL_BLOCK_BIN_NUM) {
+    return BlockAgent();
+  }
+  // blocks in the same bin may be smaller than requested, only try the first
+  if (_bins[index] != nullptr && get_size(_bins[index]) >= size) {
+    return BlockAgent(_bins[index]);
+  }
+  // any block in larger bins fits
+  index = _bin_next(index + 1);
+  if (index == SQRL_BLOCK_BIN_NUM) {
+    return BlockAgent();
+  }
+  return BlockAgent(_bins[index]);
+}
+
+// keep {size} bytes of data in a released block, the rest goes to a bin
 void BlockManager::split_block(BlockAgent agent, size_t size) {
-  split(agent._block, size);
-  // edit memory size
+  auto block = agent._block;
+  if (get_size(block) < alloc_size(size) + SQRL_BLOCK_MIN_SIZE) {
+    return;
+  }
+  _bin_remove(block);
+  split(block, size);
+  _block_count++;
+  _bin_insert(block);
+  _bin_insert(block->next);
+  if (_block_top == block) {
+    _block_top = block->next;
+  }
+}
+
+BlockAgent BlockManager::align_block(BlockAgent agent, size_t alignment) {
+  Block *block = agent._block;
+  size_t offset = aligned_offset(block, alignment);
+  if (offset == 0) {
+    return agent;
+  }
+  _bin_remove(block);
+  Block *aligned = split_at(block, offset);
+  _block_count++;
+  if (_block_top == block) {
+    _block_top = aligned;
+  }
+  // the front can not merge backwards, released blocks are merged already
+  _bin_insert(block);
+  _bin_insert(aligned);
+  return BlockAgent(aligned);
+}
+
+bool BlockManager::compact(size_t steps, size_t purge_size) {
+  if (_compact_cursor == nullptr) {
+    _compact_cursor = _block_head;
+  }
+  for (size_t i = 0; i < steps && _compact_cursor != nullptr; i++) {
+    Block *block = _compact_cursor;
+    _compact_cursor = block->next;
+    if (used(block)) {
+      continue;
+    }
+    _bin_remove(block);
+    while (adjacent(block) && !used(block->next)) {
+      _merge_next(block);
+    }
+    _compact_cursor = block->next;
+    if (block->next == nullptr) {
+      _block_top = block;
+    }
+    size_t purged = 0;
+    if (get_size(block) >= purge_size) {
+      purged = purge_block(block);
+      _memory_purged_size += purged;
+    }
+    _bin_insert(block);
+    if (purged != 0) {
+      break;
+    }
+  }
+  return _compact_cursor == nullptr;
+}
+
+size_t BlockManager::purged_size() { return _memory_purged_size; }
+
+size_t BlockManager::trim(size_t pad) {
+  Block *top = _block_top;
+  if (top == nullptr || used(top)) {
+    return 0;
+  }
+  _bin_remove(top);
+  size_t released = release_top_to_os(top, pad);
+  _bin_insert(top);
+  _memory_requested_size -= released;
+  return released;
+}
+
+size_t BlockManager::mmap_threshold() { return _mmap_threshold; }
+
+void BlockManager::set_mmap_threshold(size_t threshold) {
+  std::lock_guard<std::mutex> guard(_heap_mutex);
+  _mmap_threshold = threshold;
+  _mmap_threshold_fixed = true;
+}
+
+size_t BlockManager::release_mmap_cache(size_t max_age) {
+  size_t released = 0;
+  for (size_t i = _mmap_cache_number; i > 0; i--) {
+    if (_mmap_cache_ages[i - 1]++ < max_age) {
+      continue;
+    }
+    Block *block = _mmap_cache[i - 1];
+    released += get_size(block);
+    _mmap_cache_remove(i - 1);
+    _unmap(block);
+  }
+  return released;
+}
+
+void BlockManager::push_remote_free(BlockData *data) {
+  Block *block = get_block(data);
+  free_links_t *links = get_free_links(block);
+  _remote_free_size.fetch_add(get_size(block), std::memory_order_relaxed);
+  Block *head = _remote_frees.load(std::memory_order_relaxed);
+  do {
+    links->next = head;
+  } while (!_remote_frees.compare_exchange_weak(
+      head, block, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void BlockManager::free_remote() {
+  if (_remote_frees.load(std::memory_order_relaxed) == nullptr) {
+    return;
+  }
+  Block *block = _remote_frees.exchange(nullptr, std::memory_order_acquire);
+  while (block != nullptr) {
+    Block *next = get_free_links(block)->next;
+    if (used(block)) {
+      _heap_free_counts[size_class(get_size(block))]++;
+    }
+    // size of a block changes once it merges with neighbours
+    _remote_free_size.fetch_sub(get_size(block), std::memory_order_relaxed);
+    free_data(block->data);
+    block = next;
+  }
 }
 
 BlockAgent BlockViewer::get_head() { return BlockAgent(_block_head); }
@@ -99,16 +596,86 @@ BlockAgent BlockViewer::get_head() { return BlockAgent(_block_head); }
 BlockAgent BlockViewer::get_top() { return BlockAgent(_block_top); }
 
 void BlockManager::clear() {
-  for (auto itr = _block_head; itr != _block_top; itr = itr->next) {
+  std::lock_guard<std::mutex> guard(_heap_mutex);
+  // blocks held by thread caches are released below as well
+  for (auto itr = _thread_caches; itr != nullptr; itr = itr->_next) {
+    itr->reset();
+  }
+  for (size_t i = 0; i < _remote_list_num; i++) {
+    _remote_lists[i].store(nullptr, std::memory_order_relaxed);
+    _remote_counts[i].store(0, std::memory_order_relaxed);
+  }
+  _remote_size.store(0, std::memory_order_relaxed);
+  _remote_frees.store(nullptr, std::memory_order_relaxed);
+  _remote_free_size.store(0, std::memory_order_relaxed);
+  for (size_t i = 0; i < SQRL_BLOCK_BIN_NUM; i++) {
+    _bins[i] = nullptr;
+  }
+  for (size_t i = 0; i < _bin_map_num; i++) {
+    _bin_map[i] = 0;
+  }
+  for (size_t i = 0; i < SQRL_BLOCK_BIN_NUM; i++) {
+    _bin_counts[i] = 0;
+  }
+  _memory_free_size = 0;
+  _block_count = 0;
+  _compact_cursor = nullptr;
+  for (auto itr = _block_head; itr != nullptr; itr = itr->next) {
     used_clear(itr);
+    prev_free_clear(itr);
+  }
+  for (auto itr = _block_head; itr != nullptr; itr = itr->next) {
+    while (coalesce_block(itr)) {
+    }
+    _block_count++;
+    release_block(itr);
+    _bin_insert(itr);
+    if (itr->next == nullptr) {
+      _block_top = itr;
+    }
   }
   _memory_used_size = 0;
+  _memory_used_peak = 0;
+  release_mmap_cache();
+  _mmap_threshold = SQRL_ALLOCATOR_MMAP_THRESHOLD;
+  _mmap_threshold_fixed = false;
+#if defined(SQRL_HARDENED) && SQRL_ALLOCATOR_QUARANTINE_NUM > 0
+  std::lock_guard<std::mutex> quarantine_guard(_quarantine_mutex);
+  _quarantine_begin = 0;
+  _quarantine_number = 0;
+  _quarantine_size.store(0, std::memory_order_relaxed);
+#endif
+}
+
+static void _release(BlockData *data);
+
+void BlockManager::flush_quarantine() {
+#if defined(SQRL_HARDENED) && SQRL_ALLOCATOR_QUARANTINE_NUM > 0
+  BlockData *flushed[SQRL_ALLOCATOR_QUARANTINE_NUM];
+  size_t number = 0;
+  {
+    std::lock_guard<std::mutex> guard(_quarantine_mutex);
+    for (; _quarantine_number > 0; _quarantine_number--) {
+      flushed[number++] = _quarantine[_quarantine_begin];
+      _quarantine_begin =
+          (_quarantine_begin + 1) % SQRL_ALLOCATOR_QUARANTINE_NUM;
+    }
+    _quarantine_size.store(0, std::memory_order_relaxed);
+  }
+  // released as they would be once pushed out by later releases
+  for (size_t i = 0; i < number; i++) {
+    if (!poisoned(get_block(flushed[i]))) {
+      block_corrupted(get_block(flushed[i]), "use after free");
+    }
+    _release(flushed[i]);
+  }
+#endif
 }
 
 bool BlockViewer::safe_check() {
   auto itr = _block_head;
   while (itr != nullptr) {
-    if (itr == itr->next) {
+    if (itr == itr->next || !check_block(itr)) {
       return false;
     }
     itr = itr->next;
@@ -116,51 +683,610 @@ bool BlockViewer::safe_check() {
   return true;
 }
 
-size_t BlockViewer::memory_size() { return _memory_used_size; }
+size_t BlockViewer::memory_size() { return memory_used_size(); }
 
-size_t BlockViewer::memory_used_size() { return _memory_used_size; }
+size_t BlockViewer::memory_used_size() {
+  size_t cached = ThreadCache::total_cached_size() + _quarantined_size() +
+                  _remote_free_size.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> guard(_heap_mutex);
+  // thread caches update their size without lock, may be ahead of heap
+  return _memory_used_size > cached ? _memory_used_size - cached : 0;
+}
 
 size_t BlockViewer::memory_requested_size() { return _memory_requested_size; }
 
 size_t BlockViewer::block_number() {
-  size_t count = 0;
-  for (auto itr = _block_head; itr != _block_top; itr = itr->next) {
-    count++;
+  std::lock_guard<std::mutex> guard(_heap_mutex);
+  return _block_count;
+}
+
+AllocatorStats BlockViewer::stats() {
+  AllocatorStats stats = {};
+  std::lock_guard<std::mutex> guard(_heap_mutex);
+  // a snapshot of the heap has no release pending
+  BlockManager().free_remote();
+  for (size_t i = 0; i < SQRL_BLOCK_BIN_NUM; i++) {
+    stats.alloc_count[i] = _heap_alloc_counts[i];
+    stats.free_count[i] = _heap_free_counts[i];
+    stats.free_block_count[i] = _bin_counts[i];
+  }
+  for (auto itr = _thread_caches; itr != nullptr; itr = itr->_next) {
+    itr->add_counts(stats.alloc_count, stats.free_count);
+    stats.cached_size += itr->cached_size();
+  }
+  stats.cached_size += _remote_size.load(std::memory_order_relaxed);
+  size_t released = stats.cached_size + _quarantined_size();
+  stats.used_size =
+      _memory_used_size > released ? _memory_used_size - released : 0;
+  stats.peak_used_size = _memory_used_peak;
+  stats.requested_size = _memory_requested_size;
+  stats.mmapped_size = _memory_mmapped_size;
+  stats.huge_page_size = _memory_huge_page_size;
+  stats.mmap_cache_size = _mmap_cache_size;
+  stats.mmap_threshold = _mmap_threshold;
+  stats.heap_size = _memory_requested_size - _memory_mmapped_size;
+  stats.free_size = _memory_free_size;
+  stats.block_number = _block_count;
+  // the largest released block is in the last non-empty bin
+  for (size_t i = SQRL_BLOCK_BIN_NUM; i > 0; i--) {
+    if (_bins[i - 1] == nullptr) {
+      continue;
+    }
+    for (Block *itr = _bins[i - 1]; itr != nullptr;
+         itr = get_free_links(itr)->next) {
+      if (get_size(itr) > stats.largest_free_size) {
+        stats.largest_free_size = get_size(itr);
+      }
+    }
+    break;
+  }
+  if (stats.free_size != 0) {
+    stats.fragmentation =
+        1.0 - (double)stats.largest_free_size / stats.free_size;
+  }
+  return stats;
+}
+
+std::string AllocatorStats::dump(DumpFormat format) const {
+  std::string out;
+  char line[256];
+  const bool json = format == DumpFormat::json;
+  const char *fields[] = {"used_size",         "peak_used_size",
+                          "requested_size",    "heap_size",
+                          "mmapped_size",      "huge_page_size",
+                          "mmap_cache_size",   "mmap_threshold",
+                          "cached_size",       "free_size",
+                          "largest_free_size", "block_number"};
+  const size_t values[] = {used_size,       peak_used_size,  requested_size,
+                           heap_size,       mmapped_size,    huge_page_size,
+                           mmap_cache_size, mmap_threshold,  cached_size,
+                           free_size,       largest_free_size, block_number};
+  out += json ? "{" : "";
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    snprintf(line, sizeof(line), json ? "\"%s\": %zu, " : "%-20s%zu\n",
+             fields[i], values[i]);
+    out += line;
+  }
+  snprintf(line, sizeof(line), json ? "\"%s\": %.4f, " : "%-20s%.4f\n",
+           "fragmentation", fragmentation);
+  out += line;
+  snprintf(line, sizeof(line),
+           json ? "\"size_classes\": [" : "\n%-12s%-12s%-12s%s\n", "size",
+           "alloc", "free", "free blocks");
+  out += line;
+  bool first = true;
+  for (size_t i = 0; i < SQRL_BLOCK_BIN_NUM; i++) {
+    // only size classes ever used
+    if (alloc_count[i] == 0 && free_count[i] == 0 &&
+        free_block_count[i] == 0) {
+      continue;
+    }
+    snprintf(line, sizeof(line),
+             json ? "%s{\"min_size\": %zu, \"alloc\": %zu, \"free\": %zu, "
+                    "\"free_blocks\": %zu}"
+                  : "%s%-12zu%-12zu%-12zu%zu\n",
+             json && !first ? ", " : "", size_class_min(i), alloc_count[i],
+             free_count[i], free_block_count[i]);
+    out += line;
+    first = false;
+  }
+  out += json ? "]}" : "";
+  return out;
+}
+
+// ThreadCache
+
+ThreadCache &ThreadCache::local() {
+  static thread_local ThreadCache cache;
+  return cache;
+}
+
+ThreadCache::ThreadCache() {
+  std::lock_guard<std::mutex> guard(manager.mutex());
+  // none on 32 bit, see SQRL_BLOCK_OWNER_MASK
+  for (size_t i = 1; SQRL_BLOCK_OWNER_MASK != 0 && i < _remote_list_num;
+       i++) {
+    if (!_owners[i]) {
+      _owners[i] = true;
+      _owner = i;
+      break;
+    }
+  }
+  _next = _thread_caches;
+  if (_next != nullptr) {
+    _next->_prev = this;
+  }
+  _thread_caches = this;
+}
+
+ThreadCache::~ThreadCache() {
+  // remote free lists are left to other threads
+  for (size_t i = 0; i < bin_num; i++) {
+    if (_counts[i] != 0) {
+      _flush(i, _counts[i]);
+    }
+  }
+  std::lock_guard<std::mutex> guard(manager.mutex());
+  // blocks released to it afterwards wait for the next owner of the id
+  _free_remote_list(_owner);
+  _owners[_owner] = false;
+  // counts outlive the thread
+  add_counts(_heap_alloc_counts, _heap_free_counts);
+  // thread is exiting, any later request goes to central heap
+  _alive = false;
+  if (_prev != nullptr) {
+    _prev->_next = _next;
+  } else {
+    _thread_caches = _next;
   }
-  return count;
+  if (_next != nullptr) {
+    _next->_prev = _prev;
+  }
+}
+
+BlockData *ThreadCache::allocate(size_t size) {
+  size_t block_size = alloc_size(size);
+  if (!_alive || block_size >= SQRL_ALLOCATOR_TCACHE_MAX_SIZE) {
+    return nullptr;
+  }
+  size_t index = size_class(block_size);
+  if (_bins[index] == nullptr) {
+    _refill(index, size);
+    if (_bins[index] == nullptr) {
+      return nullptr;
+    }
+  }
+  Block *block = _bins[index];
+  free_links_t *links = get_free_links(block);
+  _bins[index] = links->next;
+  _counts[index]--;
+  // drop the key, see deallocate
+  links->prev = nullptr;
+  _sub_cached_size(get_size(block));
+  _add_count(_alloc_counts[index]);
+  return block->data;
+}
+
+bool ThreadCache::deallocate(BlockData *data) {
+  Block *block = get_block(data);
+  size_t block_size = get_size(block);
+  if (!_alive || block_size >= SQRL_ALLOCATOR_TCACHE_MAX_SIZE) {
+    return false;
+  }
+  // released to central heap already
+  if (!used(block)) {
+    return true;
+  }
+  size_t index = size_class(block_size);
+  free_links_t *links = get_free_links(block);
+  // cached blocks carry the cache as key, only scan the bin when it matches
+  if (links->prev == (Block *)this) {
+    for (auto itr = _bins[index]; itr != nullptr;
+         itr = get_free_links(itr)->next) {
+      if (itr == block) {
+#ifdef SQRL_HARDENED
+        block_corrupted(block, "double free");
+#endif
+        return true;
+      }
+    }
+  }
+  size_t owner = get_owner(block);
+  if (owner != _owner && owner != 0 && owner != SQRL_BLOCK_OWNER_REMOTE &&
+      _remote_counts[owner].load(std::memory_order_relaxed) <
+          SQRL_ALLOCATOR_TCACHE_REMOTE_COUNT) {
+    // marked first, one of two threads releasing it sees the mark
+    if (replace_owner(block, owner, SQRL_BLOCK_OWNER_REMOTE)) {
+      _push_remote(owner, block);
+      _add_count(_free_counts[index]);
+      return true;
+    }
+    owner = get_owner(block);
+  }
+  // kept here, it is owned by this cache from now on
+  if (owner != _owner && (owner == SQRL_BLOCK_OWNER_REMOTE ||
+                          !replace_owner(block, owner, _owner))) {
+#ifdef SQRL_HARDENED
+    block_corrupted(block, "double free");
+#endif
+    return true;
+  }
+  if (_counts[index] >= SQRL_ALLOCATOR_TCACHE_COUNT) {
+    _flush(index, SQRL_ALLOCATOR_TCACHE_BATCH);
+  }
+  links->prev = (Block *)this;
+  links->next = _bins[index];
+  _bins[index] = block;
+  _counts[index]++;
+  _add_cached_size(block_size);
+  _add_count(_free_counts[index]);
+  return true;
+}
+
+void ThreadCache::flush() {
+  for (size_t i = 0; i < bin_num; i++) {
+    if (_counts[i] != 0) {
+      _flush(i, _counts[i]);
+    }
+  }
+  _flush_remote();
+}
+
+void ThreadCache::reset() {
+  for (size_t i = 0; i < bin_num; i++) {
+    _bins[i] = nullptr;
+    _counts[i] = 0;
+  }
+  _cached_size.store(0, std::memory_order_relaxed);
+}
+
+size_t ThreadCache::cached_size() const {
+  return _cached_size.load(std::memory_order_relaxed);
+}
+
+size_t ThreadCache::total_cached_size() {
+  std::lock_guard<std::mutex> guard(_heap_mutex);
+  size_t total = _remote_size.load(std::memory_order_relaxed);
+  for (auto itr = _thread_caches; itr != nullptr; itr = itr->_next) {
+    total += itr->cached_size();
+  }
+  return total;
+}
+
+// take a batch of blocks of given size from central heap, unless other
+// threads released some of the size
+void ThreadCache::_refill(size_t index, size_t size) {
+  _take_remote();
+  if (_bins[index] != nullptr) {
+    return;
+  }
+  size_t block_size = alloc_size(size);
+  std::lock_guard<std::mutex> guard(manager.mutex());
+  manager.free_remote();
+  for (size_t i = 0; i < SQRL_ALLOCATOR_TCACHE_BATCH; i++) {
+    bool is_new = false;
+    BlockAgent block = manager.get_free_block(block_size);
+    if (block.null()) {
+      block = manager.get_new_block(size);
+      is_new = true;
+    } else {
+      manager.split_block(block, size);
+    }
+    if (block.null()) {
+      break;
+    }
+    manager.add_block(block, is_new);
+    Block *cached = get_block(block.get_data());
+    set_owner(cached, _owner);
+    free_links_t *links = get_free_links(cached);
+    links->prev = (Block *)this;
+    links->next = _bins[index];
+    _bins[index] = cached;
+    _counts[index]++;
+    _add_cached_size(block.size());
+  }
+}
+
+// return given number of blocks of a bin to central heap
+void ThreadCache::_flush(size_t index, size_t number) {
+  std::lock_guard<std::mutex> guard(manager.mutex());
+  for (size_t i = 0; i < number && _bins[index] != nullptr; i++) {
+    Block *block = _bins[index];
+    _bins[index] = get_free_links(block)->next;
+    _counts[index]--;
+    _sub_cached_size(get_size(block));
+    manager.free_data(block->data);
+  }
+}
+
+// chain of a remote free list is linked by free links like the bin
+void ThreadCache::_push_remote(size_t owner, Block *block) {
+  free_links_t *links = get_free_links(block);
+  // drop the key, see deallocate
+  links->prev = nullptr;
+  // counted before it is seen, so that a taker never counts below zero
+  _remote_counts[owner].fetch_add(1, std::memory_order_relaxed);
+  _remote_size.fetch_add(get_size(block), std::memory_order_relaxed);
+  Block *head = _remote_lists[owner].load(std::memory_order_relaxed);
+  do {
+    links->next = head;
+  } while (!_remote_lists[owner].compare_exchange_weak(
+      head, block, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// the whole list is taken at once, there is no ABA problem with pushes
+void ThreadCache::_take_remote() {
+  if (_owner == 0 ||
+      _remote_lists[_owner].load(std::memory_order_relaxed) == nullptr) {
+    return;
+  }
+  Block *block =
+      _remote_lists[_owner].exchange(nullptr, std::memory_order_acquire);
+  size_t taken = 0;
+  size_t size = 0;
+  while (block != nullptr) {
+    free_links_t *links = get_free_links(block);
+    Block *next = links->next;
+    size_t index = size_class(get_size(block));
+    set_owner(block, _owner);
+    links->prev = (Block *)this;
+    links->next = _bins[index];
+    _bins[index] = block;
+    _counts[index]++;
+    size += get_size(block);
+    taken++;
+    block = next;
+  }
+  _add_cached_size(size);
+  _remote_counts[_owner].fetch_sub(taken, std::memory_order_relaxed);
+  _remote_size.fetch_sub(size, std::memory_order_relaxed);
+}
+
+// central heap is held
+void ThreadCache::_free_remote_list(size_t owner) {
+  Block *block =
+      _remote_lists[owner].exchange(nullptr, std::memory_order_acquire);
+  while (block != nullptr) {
+    Block *next = get_free_links(block)->next;
+    _remote_counts[owner].fetch_sub(1, std::memory_order_relaxed);
+    _remote_size.fetch_sub(get_size(block), std::memory_order_relaxed);
+    BlockManager().free_data(block->data);
+    block = next;
+  }
+}
+
+void ThreadCache::_flush_remote() {
+  std::lock_guard<std::mutex> guard(_heap_mutex);
+  for (size_t i = 1; i < _remote_list_num; i++) {
+    _free_remote_list(i);
+  }
+  BlockManager().free_remote();
+}
+
+void ThreadCache::add_counts(size_t *alloc_count, size_t *free_count) const {
+  for (size_t i = 0; i < bin_num; i++) {
+    alloc_count[i] += _alloc_counts[i].load(std::memory_order_relaxed);
+    free_count[i] += _free_counts[i].load(std::memory_order_relaxed);
+  }
+}
+
+void ThreadCache::_add_count(std::atomic<size_t> &count) {
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+void ThreadCache::_add_cached_size(size_t size) {
+  _cached_size.store(_cached_size.load(std::memory_order_relaxed) + size,
+                     std::memory_order_relaxed);
+}
+
+void ThreadCache::_sub_cached_size(size_t size) {
+  _cached_size.store(_cached_size.load(std::memory_order_relaxed) - size,
+                     std::memory_order_relaxed);
 }
 
 // AllocatorImpl
 
+#ifdef SQRL_HARDENED
+/*
+Check a block released by user and poison it. With quarantine it is held
+back, the oldest block held is checked and returned to be released
+instead, nullptr if none is to be released yet.
+*/
+static BlockData *_harden(BlockData *data) {
+  Block *block = get_block(data);
+  if (!check_block(block)) {
+    block_corrupted(block, "corrupted block header");
+  }
+  // large blocks lie between guard pages instead
+  if (mmapped(block)) {
+    return data;
+  }
+  poison_block(block);
+#if SQRL_ALLOCATOR_QUARANTINE_NUM > 0
+  std::lock_guard<std::mutex> guard(_quarantine_mutex);
+  for (size_t i = 0; i < _quarantine_number; i++) {
+    if (_quarantine[(_quarantine_begin + i) % SQRL_ALLOCATOR_QUARANTINE_NUM] ==
+        data) {
+      block_corrupted(block, "double free");
+    }
+  }
+  _quarantine_size.fetch_add(get_size(block), std::memory_order_relaxed);
+  if (_quarantine_number < SQRL_ALLOCATOR_QUARANTINE_NUM) {
+    _quarantine[(_quarantine_begin + _quarantine_number++) %
+                SQRL_ALLOCATOR_QUARANTINE_NUM] = data;
+    return nullptr;
+  }
+  BlockData *oldest = _quarantine[_quarantine_begin];
+  _quarantine_size.fetch_sub(get_size(get_block(oldest)),
+                             std::memory_order_relaxed);
+  _quarantine[_quarantine_begin] = data;
+  _quarantine_begin = (_quarantine_begin + 1) % SQRL_ALLOCATOR_QUARANTINE_NUM;
+  if (!poisoned(get_block(oldest))) {
+    block_corrupted(get_block(oldest), "use after free");
+  }
+  return oldest;
+#else
+  return data;
+#endif
+}
+#endif
+
+// a block checked by _harden goes to thread cache or central heap
+static void _release(BlockData *data) {
+  if (ThreadCache::local().deallocate(data)) {
+    return;
+  }
+  BlockManager manager;
+  std::unique_lock<std::mutex> guard(manager.mutex(), std::try_to_lock);
+  // the holder frees it later, release never waits for the heap
+  if (!guard.owns_lock()) {
+    manager.push_remote_free(data);
+    return;
+  }
+  manager.free_remote();
+  Block *block = get_block(data);
+  // released twice is not counted, see BlockManager::free_data
+  if (used(block)) {
+    _heap_free_counts[size_class(get_size(block))]++;
+  }
+  manager.free_data(data);
+}
+
 BlockAgent GenericAllocator::find_free_block(size_t request_size) {
-  auto block = viewer.get_head();
   auto size = alloc_size(request_size);
+  // large block always comes from os, see BlockManager::free_data
+  if (size >= manager.mmap_threshold()) {
+    return BlockAgent();
+  }
+  auto block = manager.get_free_block(size);
+  if (!block.null()) {
+    manager.split_block(block, request_size);
+  }
+  return block;
+}
 
-  while (!block.null()) {
-    if (block.is_used() || block.size() < size || block.size() >= size * 2) {
-      block.next();
-      continue;
+word_t *GenericAllocator::allocate(size_t size) {
+  BlockData *data = ThreadCache::local().allocate(size);
+  if (data == nullptr) {
+    std::lock_guard<std::mutex> guard(manager.mutex());
+    manager.free_remote();
+    bool is_new = false;
+    BlockAgent block = manager.get_cached_block(size);
+    if (block.null()) {
+      block = find_free_block(size);
     }
-    // TODO split the large block
-    // maybe in Reclaimer
-    return block;
+    if (block.null()) {
+      block = manager.get_new_block(size);
+      if (block.null()) {
+        return nullptr;
+      }
+      is_new = true;
+    }
+    manager.add_block(block, is_new);
+    _heap_alloc_counts[size_class(block.size())]++;
+    data = block.get_data();
+  }
+  if (HeapProfiler::enabled()) {
+    HeapProfiler::record_allocate(data, size);
   }
-  return BlockAgent();
+  return data;
 }
 
-word_t *GenericAllocator::allocate(size_t size) {
-  bool is_new = false;
-  BlockAgent block = find_free_block(size);
+word_t *GenericAllocator::allocate_aligned(size_t size, size_t alignment) {
+  if (alignment <= SQRL_ALLOCATOR_MIN_ALIGN) {
+    return allocate(size);
+  }
+  // room for the front cut off and the aligned block, both may be the
+  // smallest block
+  size_t padded = size + alignment + 2 * SQRL_BLOCK_MIN_SIZE;
+  std::lock_guard<std::mutex> guard(manager.mutex());
+  manager.free_remote();
+  if (alloc_size(padded) >= manager.mmap_threshold()) {
+    BlockAgent block = manager.get_new_aligned_block(size, alignment);
+    if (block.null()) {
+      return nullptr;
+    }
+    manager.add_block(block, true);
+    _heap_alloc_counts[size_class(block.size())]++;
+    if (HeapProfiler::enabled()) {
+      HeapProfiler::record_allocate(block.get_data(), size);
+    }
+    return block.get_data();
+  }
+  BlockAgent block = find_free_block(padded);
   if (block.null()) {
-    block = manager.get_new_block(size);
-    is_new = true;
+    // a new block goes to a bin first, the same path as a released one
+    block = manager.get_new_block(padded);
+    if (block.null()) {
+      return nullptr;
+    }
+    manager.add_block(block, true);
+    manager.free_data(block.get_data());
+    block = find_free_block(padded);
+  }
+  block = manager.align_block(block, alignment);
+  // the rest after data goes back to a bin
+  manager.split_block(block, size);
+  manager.add_block(block, false);
+  _heap_alloc_counts[size_class(block.size())]++;
+  if (HeapProfiler::enabled()) {
+    HeapProfiler::record_allocate(block.get_data(), size);
   }
-  manager.add_block(block, is_new);
   return block.get_data();
 }
 
+word_t *GenericAllocator::resize(word_t *data, size_t size) {
+  std::lock_guard<std::mutex> guard(manager.mutex());
+  manager.free_remote();
+  Block *block = get_block(data);
+  // large and small blocks stay what they are, see find_free_block
+  bool large = alloc_size(size) >= manager.mmap_threshold();
+  if (mmapped(block)) {
+    BlockAgent moved = large ? manager.remap_block(block, size) : BlockAgent();
+    return moved.null() ? nullptr : moved.get_data();
+  }
+  if (large || !manager.resize_block(block, size)) {
+    return nullptr;
+  }
+  return data;
+}
+
+word_t *GenericAllocator::reallocate(word_t *data, size_t size) {
+  if (data == nullptr) {
+    return allocate(size);
+  }
+  size_t old_size = get_size(get_block(data)) - sizeof(BlockHeader);
+  word_t *resized = resize(data, size);
+  if (resized != nullptr) {
+    if (HeapProfiler::tracking()) {
+      HeapProfiler::record_deallocate(data);
+    }
+    if (HeapProfiler::enabled()) {
+      HeapProfiler::record_allocate(resized, size);
+    }
+    return resized;
+  }
+  word_t *moved = allocate(size);
+  if (moved == nullptr) {
+    return nullptr;
+  }
+  memcpy(moved, data, old_size < size ? old_size : size);
+  deallocate(data, old_size);
+  return moved;
+}
+
 void GenericAllocator::deallocate(word_t *data, size_t) {
-  manager.free_data(data);
+  if (HeapProfiler::tracking()) {
+    HeapProfiler::record_deallocate(data);
+  }
+#ifdef SQRL_HARDENED
+  data = _harden(data);
+  if (data == nullptr) {
+    return;
+  }
+#endif
+  _release(data);
 }
 
 }; // namespace sqrl
\ No newline at end of file
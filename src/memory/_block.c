@@ -1,19 +1,129 @@
+// mremap is a GNU extension
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 // system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
 
 #include <memory/_block.h>
 
-bool used(block_t *block) { return block->_size & 1; }
+/*
+Header of a block which is used may be read by any thread,
+while its flags are changed by the thread holding the heap
+*/
+static size_t load_size(block_t *block) {
+  return __atomic_load_n(&block->_size, __ATOMIC_RELAXED);
+}
+
+bool used(block_t *block) { return load_size(block) & SQRL_BLOCK_USED; }
+
+void used_set(block_t *block) {
+  __atomic_fetch_or(&block->_size, SQRL_BLOCK_USED, __ATOMIC_RELAXED);
+}
+
+void used_clear(block_t *block) {
+  __atomic_fetch_and(&block->_size, ~(size_t)SQRL_BLOCK_USED,
+                     __ATOMIC_RELAXED);
+}
+
+bool prev_free(block_t *block) {
+  return load_size(block) & SQRL_BLOCK_PREV_FREE;
+}
+
+void prev_free_set(block_t *block) {
+  __atomic_fetch_or(&block->_size, SQRL_BLOCK_PREV_FREE, __ATOMIC_RELAXED);
+}
+
+void prev_free_clear(block_t *block) {
+  __atomic_fetch_and(&block->_size, ~(size_t)SQRL_BLOCK_PREV_FREE,
+                     __ATOMIC_RELAXED);
+}
+
+bool mmapped(block_t *block) {
+  return load_size(block) & SQRL_BLOCK_MMAPPED;
+}
+
+size_t get_size(block_t *block) {
+  return load_size(block) & ~((size_t)SQRL_BLOCK_FLAGS | SQRL_BLOCK_OWNER_MASK);
+}
+
+size_t get_owner(block_t *block) {
+  return (load_size(block) & SQRL_BLOCK_OWNER_MASK) >> SQRL_BLOCK_OWNER_SHIFT;
+}
+
+void set_owner(block_t *block, size_t owner) {
+  size_t size = load_size(block);
+  while (!replace_owner(block, (size & SQRL_BLOCK_OWNER_MASK) >>
+                                   SQRL_BLOCK_OWNER_SHIFT,
+                        owner)) {
+    size = load_size(block);
+  }
+}
+
+// flags may change meanwhile, they are kept
+bool replace_owner(block_t *block, size_t expected, size_t owner) {
+  size_t size = load_size(block);
+  size_t bits = (owner << SQRL_BLOCK_OWNER_SHIFT) & SQRL_BLOCK_OWNER_MASK;
+  while ((size & SQRL_BLOCK_OWNER_MASK) >> SQRL_BLOCK_OWNER_SHIFT ==
+         expected) {
+    if (__atomic_compare_exchange_n(&block->_size, &size,
+                                    (size & ~SQRL_BLOCK_OWNER_MASK) | bits,
+                                    true, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-void used_set(block_t *block) { block->_size |= 1; }
+#ifdef SQRL_HARDENED
+// address of a static differs from run to run, canaries can't be guessed
+static const size_t _canary_key = 0x5a17c0dedeadbeefULL;
 
-void used_clear(block_t *block) { block->_size &= ~1; }
+// flags are left out, they are changed by neighbours
+static size_t _canary(block_t *block) {
+  return (uintptr_t)block ^ get_size(block) ^ _canary_key ^
+         (uintptr_t)&_canary_key;
+}
+#endif
+
+// flags and owner are kept
+void set_size(block_t *block, size_t size) {
+  size_t flags =
+      load_size(block) & ((size_t)SQRL_BLOCK_FLAGS | SQRL_BLOCK_OWNER_MASK);
+  __atomic_store_n(&block->_size, size | flags, __ATOMIC_RELAXED);
+#ifdef SQRL_HARDENED
+  block->canary = _canary(block);
+#endif
+}
+
+// header of a new block, size comes with its flags
+static void init_size(block_t *block, size_t size) {
+  block->_size = size;
+#ifdef SQRL_HARDENED
+  block->canary = _canary(block);
+#endif
+}
 
-size_t get_size(block_t *block) { return block->_size ^ (block->_size & 1); }
+bool check_block(block_t *block) {
+#ifdef SQRL_HARDENED
+  return block->canary == _canary(block);
+#else
+  (void)block;
+  return true;
+#endif
+}
 
-void set_size(block_t *block, size_t size) { block->_size = size; }
+void block_corrupted(block_t *block, const char *reason) {
+  fprintf(stderr, "squirrel: %s, block %p\n", reason, (void *)block);
+  abort();
+}
 
 /*
 Memory Align:
@@ -26,28 +136,203 @@ align(12) -> 12
 */
 size_t align(size_t n) { return (n + word_s - 1) & ~(word_s - 1); }
 
-size_t alloc_size(size_t size) { return align(size + sizeof(block_header_t)); }
+// block size keeps lowest bits for flags, also on x32
+size_t alloc_size(size_t size) {
+  size_t total = align(size + sizeof(block_header_t));
+  total = (total + SQRL_BLOCK_FLAGS) & ~(size_t)SQRL_BLOCK_FLAGS;
+  return total < SQRL_BLOCK_MIN_SIZE ? SQRL_BLOCK_MIN_SIZE : total;
+}
+
+static int _backend = SQRL_BLOCK_DEFAULT_BACKEND;
+static size_t _arena_size = SQRL_BLOCK_ARENA_SIZE;
+// unused part of the current arena, blocks are carved from its beginning
+static char *_arena_cursor = NULL;
+static char *_arena_end = NULL;
+
+void set_block_backend(int backend) { _backend = backend; }
+
+int get_block_backend() { return _backend; }
+
+void set_arena_size(size_t size) { _arena_size = size; }
+
+static bool _huge_page = false;
+
+void set_huge_page(bool enable) { _huge_page = enable; }
+
+bool get_huge_page() { return _huge_page; }
+
+bool huge_page(block_t *block) {
+  return mmapped(block) && block->next == block;
+}
+
+void *heap_end() {
+  if (_backend == SQRL_BLOCK_BACKEND_ARENA) {
+    return _arena_cursor;
+  }
+  return sbrk(0);
+}
+
+/*
+Carve a block out of the current arena, a new arena is mapped once it
+runs out. The rest of the old arena is left behind, its pages are
+never touched so they cost address space only.
+*/
+static void *_arena_carve(size_t size) {
+  if (_arena_cursor == NULL || (size_t)(_arena_end - _arena_cursor) < size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t arena = size > _arena_size ? size : _arena_size;
+    arena = (arena + page - 1) & ~(page - 1);
+    char *begin = mmap(0, arena, PROT_READ | PROT_WRITE,
+                       MAP_ANON | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    if (begin == MAP_FAILED) {
+      return NULL;
+    }
+    _arena_cursor = begin;
+    _arena_end = begin + arena;
+  }
+  void *block = _arena_cursor;
+  _arena_cursor += size;
+  return block;
+}
 
 block_t *request_block_from_os(size_t size) {
-  // current top of the heap
-  // if sbrk success, it will also be the beginning of the new block
-  block_t *block = (block_t *)sbrk(0);
-    if (sbrk(alloc_size(size)) == (void *)-1) {
+  block_t *block;
+  if (_backend == SQRL_BLOCK_BACKEND_ARENA) {
+    block = (block_t *)_arena_carve(alloc_size(size));
+    if (block == NULL) {
       return NULL;
     }
-  set_size(block, alloc_size(size));
-  used_set(block);
+  } else {
+    // previous top of the heap is the beginning of the new block
+    block = (block_t *)sbrk(alloc_size(size));
+    if (block == (void *)-1) {
+      return NULL;
+    }
+  }
+  init_size(block, alloc_size(size) | SQRL_BLOCK_USED);
+  block->next = NULL;
   return block;
 }
 
+/*
+Map {size} bytes, a multiple of SQRL_BLOCK_HUGE_PAGE_SIZE, backed by huge
+pages. MAP_HUGETLB works only with huge pages reserved by the system,
+otherwise the mapping is trimmed to be aligned to a huge page and
+transparent huge pages are asked for by madvise.
+*/
+static void *_map_huge_page(size_t size) {
+  void *begin;
+#ifdef MAP_HUGETLB
+  begin = mmap(0, size, PROT_READ | PROT_WRITE,
+               MAP_ANON | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+  if (begin != MAP_FAILED) {
+    return begin;
+  }
+#endif
+  size_t total = size + SQRL_BLOCK_HUGE_PAGE_SIZE;
+  char *mapped = mmap(0, total, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,
+                      -1, 0);
+  if (mapped == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  char *aligned = (char *)(((uintptr_t)mapped + SQRL_BLOCK_HUGE_PAGE_SIZE - 1) &
+                           ~(uintptr_t)(SQRL_BLOCK_HUGE_PAGE_SIZE - 1));
+  if (aligned != mapped) {
+    munmap(mapped, aligned - mapped);
+  }
+  if (mapped + total != aligned + size) {
+    munmap(aligned + size, mapped + total - (aligned + size));
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+#ifdef SQRL_HARDENED
+/*
+Map {size} bytes rounded up to pages between two guard pages, any access
+to them faults. Return where the usable pages begin.
+*/
+static char *_map_guarded(size_t size) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size = (size + page - 1) & ~(page - 1);
+  char *begin = mmap(0, size + 2 * page, PROT_NONE, MAP_ANON | MAP_PRIVATE,
+                     -1, 0);
+  if (begin == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  if (mprotect(begin + page, size, PROT_READ | PROT_WRITE) != 0) {
+    munmap(begin, size + 2 * page);
+    return MAP_FAILED;
+  }
+  return begin + page;
+}
+#endif
+
 block_t *request_large_block_from_os(size_t size){
-  block_t *block = mmap(0, alloc_size(size), PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
-  if (block == NULL){
+  if (_huge_page && alloc_size(size) >= SQRL_BLOCK_HUGE_PAGE_SIZE) {
+    size_t total = (alloc_size(size) + SQRL_BLOCK_HUGE_PAGE_SIZE - 1) &
+                   ~(size_t)(SQRL_BLOCK_HUGE_PAGE_SIZE - 1);
+    block_t *block = _map_huge_page(total);
+    if (block == MAP_FAILED) {
+      return NULL;
+    }
+    init_size(block, total | SQRL_BLOCK_USED | SQRL_BLOCK_MMAPPED);
+    // tells it from blocks of plain pages, see huge_page
+    block->next = block;
     return block;
   }
-  set_size(block, alloc_size(size));
-  used_set(block);
+#ifdef SQRL_HARDENED
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t total = (alloc_size(size) + page - 1) & ~(page - 1);
+  char *pages = _map_guarded(total);
+  if (pages == MAP_FAILED) {
+    return NULL;
+  }
+  // an overflow runs into the guard page right after the block
+  block_t *block = (block_t *)(pages + total - alloc_size(size));
+  init_size(block, alloc_size(size) | SQRL_BLOCK_USED | SQRL_BLOCK_MMAPPED);
+  block->next = (block_t *)(pages - page);
+  return block;
+#else
+  block_t *block = mmap(0, alloc_size(size), PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+  if (block == MAP_FAILED){
+    return NULL;
+  }
+  init_size(block, alloc_size(size) | SQRL_BLOCK_USED | SQRL_BLOCK_MMAPPED);
+  block->next = NULL;
   return block;
+#endif
+}
+
+/*
+Poisoned part of a released block, from the end of its free links to its
+footer, both are written once it joins a bin or a thread cache
+*/
+static char *_poison_begin(block_t *block) {
+  return (char *)(get_free_links(block) + 1);
+}
+
+static char *_poison_end(block_t *block) {
+  return (char *)block + get_size(block) - sizeof(size_t);
+}
+
+void poison_block(block_t *block) {
+  char *begin = _poison_begin(block);
+  if (begin < _poison_end(block)) {
+    memset(begin, SQRL_BLOCK_POISON, _poison_end(block) - begin);
+  }
+}
+
+bool poisoned(block_t *block) {
+  char *end = _poison_end(block);
+  for (char *itr = _poison_begin(block); itr < end; itr++) {
+    if (*(unsigned char *)itr != SQRL_BLOCK_POISON) {
+      return false;
+    }
+  }
+  return true;
 }
 
 block_header_t *get_header(word_t *data) {
@@ -58,49 +343,335 @@ block_t *get_block(word_t *data){
   return (block_t*)((block_header_t *)data - 1);
 }
 
+bool adjacent(block_t *block) {
+  return block->next != NULL &&
+         (char *)block + get_size(block) == (char *)block->next;
+}
+
+// boundary tag, last word of a released block is its size
+void set_footer(block_t *block) {
+  *(size_t *)((char *)block + get_size(block) - sizeof(size_t)) =
+      get_size(block);
+}
+
+block_t *get_prev_free(block_t *block) {
+  if (!prev_free(block)) {
+    return NULL;
+  }
+  size_t prev_size = *((size_t *)block - 1);
+  return (block_t *)((char *)block - prev_size);
+}
+
 // Mark block as unused
 void release_block(block_t *block) {
   used_clear(block);
+  set_footer(block);
+  if (adjacent(block)) {
+    prev_free_set(block->next);
+  }
+}
+
+// Mark block as used
+void acquire_block(block_t *block) {
+  used_set(block);
+  if (adjacent(block)) {
+    prev_free_clear(block->next);
+  }
+}
+
+// data of the block is aligned to {alignment}
+block_t *request_aligned_large_block_from_os(size_t size, size_t alignment) {
+  // mapping is page aligned, the header before data takes up to
+  // {alignment} bytes
+  size_t total = alloc_size(size) + alignment;
+#ifdef SQRL_HARDENED
+  char *begin = _map_guarded(total);
+#else
+  char *begin = mmap(0, total, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,
+                     -1, 0);
+#endif
+  if (begin == MAP_FAILED) {
+    return NULL;
+  }
+  uintptr_t data = (uintptr_t)begin + sizeof(block_header_t);
+  data = (data + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  block_t *block = (block_t *)(data - sizeof(block_header_t));
+  size_t pad = (char *)block - begin;
+  init_size(block, (total - pad) | SQRL_BLOCK_USED | SQRL_BLOCK_MMAPPED);
+  // never chained, next keeps where the mapping begins, see huge_page
+#ifdef SQRL_HARDENED
+  block->next = (block_t *)(begin - sysconf(_SC_PAGESIZE));
+#else
+  block->next = pad == 0 ? NULL : (block_t *)begin;
+#endif
+  return block;
+}
+
+block_t *remap_large_block(block_t *block, size_t size) {
+  // only a mapping beginning at the block moves as a whole
+  if (!mmapped(block) || block->next != NULL) {
+    return NULL;
+  }
+  block_t *moved =
+      mremap(block, get_size(block), alloc_size(size), MREMAP_MAYMOVE);
+  if (moved == MAP_FAILED) {
+    return NULL;
+  }
+  set_size(moved, alloc_size(size));
+  return moved;
 }
 
 // return memory back to os
 int release_large_block_to_os(block_t *block) {
-  return munmap(block, block->_size);
+  char *begin = block->next == NULL ? (char *)block : (char *)block->next;
+  char *end = (char *)block + get_size(block);
+#ifdef SQRL_HARDENED
+  if (!huge_page(block)) {
+    // up to the end of the guard page after the block
+    size_t page = sysconf(_SC_PAGESIZE);
+    end = (char *)(((uintptr_t)end + page - 1) & ~(uintptr_t)(page - 1)) +
+          page;
+  }
+#endif
+  return munmap(begin, end - begin);
+}
+
+/*
+Shrink a released block at the top of the heap to {keep} bytes and
+return the rest back to os, it only works when the block still ends
+at heap_end. Return size given back.
+*/
+size_t release_top_to_os(block_t *block, size_t keep) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  char *end = (char *)block + get_size(block);
+  if (used(block) || keep < SQRL_BLOCK_MIN_SIZE || heap_end() != end) {
+    return 0;
+  }
+  // new program break is page aligned
+  char *new_end =
+      (char *)(((uintptr_t)block + keep + page - 1) & ~(uintptr_t)(page - 1));
+  if (new_end >= end) {
+    return 0;
+  }
+  size_t release = end - new_end;
+  if (_backend == SQRL_BLOCK_BACKEND_ARENA) {
+    // the arena stays mapped, its pages are carved again later
+    if (madvise(new_end, release, MADV_DONTNEED) != 0) {
+      return 0;
+    }
+    _arena_cursor = new_end;
+  } else if (sbrk(-(intptr_t)release) == (void *)-1) {
+    return 0;
+  }
+  set_size(block, new_end - (char *)block);
+  set_footer(block);
+  return release;
 }
 
+/*
+Give pages inside a released block back to os, the block is still there
+and its pages come back zeroed once touched again.
+Return size given back, 0 if the block is purged already.
+*/
+size_t purge_block(block_t *block) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  // the word after free links remembers block size when it was purged
+  size_t *purged = (size_t *)(get_free_links(block) + 1);
+  // too small to hold a whole page
+  if (used(block) || get_size(block) < 2 * page ||
+      *purged == get_size(block)) {
+    return 0;
+  }
+  // keep header, free links, the mark and footer
+  uintptr_t begin =
+      ((uintptr_t)(purged + 1) + page - 1) & ~(uintptr_t)(page - 1);
+  uintptr_t end = ((uintptr_t)block + get_size(block) - sizeof(size_t)) &
+                  ~(uintptr_t)(page - 1);
+  if (end <= begin || madvise((void *)begin, end - begin, MADV_DONTNEED) != 0) {
+    return 0;
+  }
+  *purged = get_size(block);
+  return end - begin;
+}
+
+/*
+Keep {size} bytes of data in the block,
+the rest becomes a new released block right after it
+*/
 void split(block_t *block, size_t size) {
-  if (used(block)) {
-    return;
+  split_at(block, alloc_size(size));
+}
+
+block_t *shrink_block(block_t *block, size_t size) {
+  size_t offset = alloc_size(size);
+  if (get_size(block) < offset + SQRL_BLOCK_MIN_SIZE) {
+    return NULL;
+  }
+  block_t *rest = (block_t *)((char *)block + offset);
+  // block before the rest is used
+  init_size(rest, get_size(block) - offset);
+  rest->next = block->next;
+  set_size(block, offset);
+  block->next = rest;
+  release_block(rest);
+  return rest;
+}
+
+bool absorb_next_block(block_t *block) {
+  block_t *next = block->next;
+  if (!adjacent(block) || used(next)) {
+    return false;
+  }
+  set_size(block, get_size(block) + get_size(next));
+  block->next = next->next;
+  if (adjacent(block)) {
+    prev_free_clear(block->next);
+  }
+  return true;
+}
+
+size_t extend_top_block(block_t *block, size_t size) {
+  char *end = (char *)block + get_size(block);
+  if (alloc_size(size) <= get_size(block) || heap_end() != end) {
+    return 0;
+  }
+  size_t more = alloc_size(size) - get_size(block);
+  if (_backend == SQRL_BLOCK_BACKEND_ARENA) {
+    if ((size_t)(_arena_end - _arena_cursor) < more) {
+      return 0;
+    }
+    _arena_cursor += more;
+  } else {
+    void *begin = sbrk(more);
+    if (begin == (void *)-1) {
+      return 0;
+    }
+    // someone else moves program break in between
+    if (begin != end) {
+      sbrk(-(intptr_t)more);
+      return 0;
+    }
   }
+  set_size(block, get_size(block) + more);
+  return more;
+}
 
-  // assume size here is already align
-  if (get_size(block) <= size) {
-    return;
+/*
+Cut a released block at {offset} bytes from its beginning, both parts are
+released blocks. Return the second one, NULL if either part is too small.
+*/
+block_t *split_at(block_t *block, size_t offset) {
+  if (used(block)) {
+    return NULL;
+  }
+  // the rest is too small to be a block
+  if (offset < SQRL_BLOCK_MIN_SIZE ||
+      get_size(block) < offset + SQRL_BLOCK_MIN_SIZE) {
+    return NULL;
   }
 
-  block_t *new_block =
-      (block_t *)((char *)(block) + size + sizeof(block_header_t));
-  set_size(new_block, get_size(block) - size - sizeof(block_header_t));
-  set_size(block, size);
+  block_t *new_block = (block_t *)((char *)(block) + offset);
+  init_size(new_block, (get_size(block) - offset) | SQRL_BLOCK_PREV_FREE);
+  set_size(block, offset);
+  set_footer(block);
+  set_footer(new_block);
 
   // add new block into the chain
   block_t *previous_next = block->next;
   block->next = new_block;
   new_block->next = previous_next;
+  return new_block;
+}
+
+/*
+Distance from a block to a block inside it whose data is aligned to
+{alignment}, it is either 0 or large enough for the part before to be a
+block on its own.
+*/
+size_t aligned_offset(block_t *block, size_t alignment) {
+  uintptr_t data = (uintptr_t)block->data;
+  uintptr_t aligned = (data + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  while (aligned != data && aligned - data < SQRL_BLOCK_MIN_SIZE) {
+    aligned += alignment;
+  }
+  return aligned - data;
 }
 
 // only walk one step
-void coalesce_block(block_t *block) {
+bool coalesce_block(block_t *block) {
   if (block == NULL) {
-    return;
+    return false;
   }
   if (used(block)) {
-    return;
+    return false;
   }
   block_t *walk_ptr = block->next;
-  if (walk_ptr != NULL && !used(walk_ptr)) {
+  if (walk_ptr != NULL && !used(walk_ptr) && adjacent(block)) {
     set_size(block, get_size(block) + get_size(walk_ptr));
     block->next = walk_ptr->next;
+    set_footer(block);
+    return true;
+  }
+  return false;
+}
+
+/*
+Size Class:
+- x64
+size_class(32) -> 4
+size_class(504) -> 63
+size_class(512) -> 64
+size_class(640) -> 65
+size_class(1024) -> 68
+*/
+size_t size_class(size_t size) {
+  if (size < SQRL_BLOCK_SMALL_BIN_LIMIT) {
+    return size / word_s;
+  }
+  size_t fl = sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(size);
+  size_t sl = (size >> (fl - 2)) & (SQRL_BLOCK_BIN_SUB_NUM - 1);
+  return SQRL_BLOCK_SMALL_BIN_NUM +
+         (fl - SQRL_BLOCK_SMALL_BIN_SHIFT) * SQRL_BLOCK_BIN_SUB_NUM + sl;
+}
+
+size_t size_class_min(size_t index) {
+  if (index < SQRL_BLOCK_SMALL_BIN_NUM) {
+    return index * word_s;
   }
-  return;
-}
\ No newline at end of file
+  index -= SQRL_BLOCK_SMALL_BIN_NUM;
+  size_t fl = index / SQRL_BLOCK_BIN_SUB_NUM + SQRL_BLOCK_SMALL_BIN_SHIFT;
+  size_t sl = index % SQRL_BLOCK_BIN_SUB_NUM;
+  return ((size_t)1 << fl) + sl * ((size_t)1 << (fl - 2));
+}
+
+free_links_t *get_free_links(block_t *block) {
+  return (free_links_t *)block->data;
+}
+
+void free_list_push(block_t **head, block_t *block) {
+  free_links_t *links = get_free_links(block);
+  links->prev = NULL;
+  links->next = *head;
+  if (*head != NULL) {
+    get_free_links(*head)->prev = block;
+  }
+  *head = block;
+}
+
+void free_list_remove(block_t **head, block_t *block) {
+#ifdef SQRL_HARDENED
+  // overflow of the block before it
+  if (!check_block(block)) {
+    block_corrupted(block, "corrupted header of released block");
+  }
+#endif
+  free_links_t *links = get_free_links(block);
+  if (links->prev != NULL) {
+    get_free_links(links->prev)->next = links->next;
+  } else {
+    *head = links->next;
+  }
+  if (links->next != NULL) {
+    get_free_links(links->next)->prev = links->prev;
+  }
+}
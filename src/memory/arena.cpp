@@ -0,0 +1,98 @@
+#include <memory/arena.h>
+
+namespace sqrl {
+
+static const size_t _arena_align = alignof(std::max_align_t);
+
+static char *_align_up(char *ptr, size_t alignment) {
+  return (char *)(((uintptr_t)ptr + alignment - 1) &
+                  ~(uintptr_t)(alignment - 1));
+}
+
+MonotonicArena::MonotonicArena(size_t chunk_size)
+    : MonotonicArena(nullptr, 0, chunk_size) {}
+
+MonotonicArena::MonotonicArena(void *buffer, size_t size, size_t chunk_size)
+    : chunk_size(chunk_size), buffer(buffer), buffer_size(size),
+      head(nullptr), current(nullptr), cursor((char *)buffer),
+      end((char *)buffer + size), allocated(0) {}
+
+MonotonicArena::~MonotonicArena() { release(); }
+
+word_t *MonotonicArena::allocate(size_t size) {
+  return allocate_aligned(size, _arena_align);
+}
+
+word_t *MonotonicArena::allocate_aligned(size_t size, size_t alignment) {
+  if (alignment < _arena_align) {
+    alignment = _arena_align;
+  }
+  char *data = _align_up(cursor, alignment);
+  if (cursor == nullptr || data + size > end) {
+    if (!next_chunk(size, alignment)) {
+      return nullptr;
+    }
+    data = _align_up(cursor, alignment);
+  }
+  cursor = data + size;
+  allocated += size;
+  return (word_t *)data;
+}
+
+bool MonotonicArena::next_chunk(size_t size, size_t alignment) {
+  size_t required = sizeof(Chunk) + alignment + size;
+  // reuse chunks kept by reset first
+  Chunk *chunk = current == nullptr ? head : current->next;
+  Chunk *last = current;
+  while (chunk != nullptr && chunk->size < required) {
+    last = chunk;
+    chunk = chunk->next;
+  }
+  if (chunk == nullptr) {
+    size_t chunk_bytes = required > chunk_size ? required : chunk_size;
+    chunk = (Chunk *)upstream.allocate(chunk_bytes);
+    if (chunk == nullptr) {
+      return false;
+    }
+    chunk->size = chunk_bytes;
+    chunk->next = nullptr;
+    // skipped chunks stay in the chain for next reset
+    while (last != nullptr && last->next != nullptr) {
+      last = last->next;
+    }
+    if (last == nullptr) {
+      head = chunk;
+    } else {
+      last->next = chunk;
+    }
+  }
+  current = chunk;
+  cursor = (char *)(chunk + 1);
+  end = (char *)chunk + chunk->size;
+  return true;
+}
+
+void MonotonicArena::reset() {
+  current = nullptr;
+  cursor = (char *)buffer;
+  end = (char *)buffer + buffer_size;
+  allocated = 0;
+}
+
+void MonotonicArena::release() {
+  while (head != nullptr) {
+    Chunk *next = head->next;
+    upstream.deallocate((word_t *)head, head->size);
+    head = next;
+  }
+  reset();
+}
+
+size_t MonotonicArena::allocated_size() const { return allocated; }
+
+MonotonicArena &MonotonicArena::local() {
+  static thread_local MonotonicArena arena;
+  return arena;
+}
+
+}; // namespace sqrl
@@ -0,0 +1,242 @@
+#include <memory/profiler.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <execinfo.h>
+#include <mutex>
+
+namespace sqrl {
+
+struct ProfileSite {
+  void *stack[SQRL_PROFILER_DEPTH];
+  int depth;
+  size_t hash;
+  size_t samples;
+  size_t bytes;
+  size_t live_samples;
+  size_t live_bytes;
+};
+
+struct LiveSample {
+  word_t *data;
+  size_t site;
+  size_t size;
+};
+
+static std::mutex _profiler_mutex;
+static std::atomic<size_t> _sample_rate{SQRL_PROFILER_SAMPLE_RATE};
+static ProfileSite _sites[SQRL_PROFILER_SITE_NUM];
+static size_t _site_number = 0;
+static LiveSample _live[SQRL_PROFILER_LIVE_NUM];
+static size_t _live_number = 0;
+// live samples by the slot they hash to, a release finding none of its
+// slot was never sampled and returns without the lock
+static std::atomic<uint16_t> _live_homes[SQRL_PROFILER_LIVE_NUM] = {};
+// samples dropped once tables are full
+static size_t _dropped = 0;
+
+// bytes allocated by current thread since its last sample
+static thread_local size_t _sampled_bytes = 0;
+
+static size_t _hash(const void *const *stack, int depth) {
+  size_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < depth; i++) {
+    hash = (hash ^ (uintptr_t)stack[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+static size_t _find_site(void **stack, int depth) {
+  size_t hash = _hash(stack, depth);
+  for (size_t i = 0; i < SQRL_PROFILER_SITE_NUM; i++) {
+    size_t index = (hash + i) % SQRL_PROFILER_SITE_NUM;
+    ProfileSite &site = _sites[index];
+    if (site.depth == 0) {
+      site.depth = depth;
+      site.hash = hash;
+      for (int j = 0; j < depth; j++) {
+        site.stack[j] = stack[j];
+      }
+      _site_number++;
+      return index;
+    }
+    if (site.hash == hash && site.depth == depth) {
+      return index;
+    }
+  }
+  return SQRL_PROFILER_SITE_NUM;
+}
+
+static size_t _live_index(word_t *data) {
+  return ((uintptr_t)data >> 4) % SQRL_PROFILER_LIVE_NUM;
+}
+
+// empty slot {hole}, samples after it move back so that probing stops at
+// the first empty slot, no tombstone is left behind
+static void _live_remove(size_t hole) {
+  _live[hole] = LiveSample{};
+  size_t index = (hole + 1) % SQRL_PROFILER_LIVE_NUM;
+  while (_live[index].data != nullptr) {
+    size_t home = _live_index(_live[index].data);
+    // distance probed from home, the sample may fill the hole unless its
+    // home lies after the hole
+    size_t probed = (index - home + SQRL_PROFILER_LIVE_NUM) %
+                    SQRL_PROFILER_LIVE_NUM;
+    size_t gap = (index - hole + SQRL_PROFILER_LIVE_NUM) %
+                 SQRL_PROFILER_LIVE_NUM;
+    if (probed >= gap) {
+      _live[hole] = _live[index];
+      _live[index] = LiveSample{};
+      hole = index;
+    }
+    index = (index + 1) % SQRL_PROFILER_LIVE_NUM;
+  }
+}
+
+void HeapProfiler::start(size_t sample_rate) {
+  reset();
+  std::lock_guard<std::mutex> guard(_profiler_mutex);
+  _sample_rate = sample_rate == 0 ? 1 : sample_rate;
+  _tracking.store(true, std::memory_order_relaxed);
+  _enabled.store(true, std::memory_order_relaxed);
+}
+
+void HeapProfiler::stop() { _enabled.store(false, std::memory_order_relaxed); }
+
+void HeapProfiler::reset() {
+  std::lock_guard<std::mutex> guard(_profiler_mutex);
+  for (size_t i = 0; i < SQRL_PROFILER_SITE_NUM; i++) {
+    _sites[i] = ProfileSite{};
+  }
+  _tracking.store(false, std::memory_order_relaxed);
+  for (size_t i = 0; i < SQRL_PROFILER_LIVE_NUM; i++) {
+    _live[i] = LiveSample{};
+    _live_homes[i].store(0, std::memory_order_relaxed);
+  }
+  _site_number = 0;
+  _live_number = 0;
+  _dropped = 0;
+}
+
+void HeapProfiler::record_allocate(word_t *data, size_t size) {
+  if (data == nullptr) {
+    return;
+  }
+  size_t sample_rate = _sample_rate.load(std::memory_order_relaxed);
+  _sampled_bytes += size;
+  if (_sampled_bytes < sample_rate) {
+    return;
+  }
+  _sampled_bytes %= sample_rate;
+  // skip this hook and the allocator calling it
+  void *frames[SQRL_PROFILER_DEPTH + 2];
+  int depth = backtrace(frames, SQRL_PROFILER_DEPTH + 2) - 2;
+  if (depth <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(_profiler_mutex);
+  size_t site = _find_site(frames + 2, depth);
+  if (site == SQRL_PROFILER_SITE_NUM ||
+      _live_number == SQRL_PROFILER_LIVE_NUM / 2) {
+    _dropped++;
+    return;
+  }
+  _sites[site].samples++;
+  _sites[site].bytes += size;
+  _sites[site].live_samples++;
+  _sites[site].live_bytes += size;
+  // tables stay half empty so probing is short
+  size_t home = _live_index(data);
+  size_t index = home;
+  while (_live[index].data != nullptr) {
+    index = (index + 1) % SQRL_PROFILER_LIVE_NUM;
+  }
+  _live[index] = LiveSample{data, site, size};
+  _live_number++;
+  _live_homes[home].fetch_add(1, std::memory_order_release);
+}
+
+void HeapProfiler::record_deallocate(word_t *data) {
+  size_t home = _live_index(data);
+  // sampled blocks were recorded before they could be released
+  if (_live_homes[home].load(std::memory_order_acquire) == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(_profiler_mutex);
+  for (size_t index = home; _live[index].data != nullptr;
+       index = (index + 1) % SQRL_PROFILER_LIVE_NUM) {
+    LiveSample &live = _live[index];
+    if (live.data == data) {
+      _sites[live.site].live_samples--;
+      _sites[live.site].live_bytes -= live.size;
+      _live_number--;
+      _live_homes[home].fetch_sub(1, std::memory_order_relaxed);
+      _live_remove(index);
+      return;
+    }
+  }
+}
+
+// symbols may carry quotes, e.g. from templates with string literal
+static void _append_escaped(std::string &out, const char *str) {
+  for (; *str != '\0'; str++) {
+    if (*str == '"' || *str == '\\') {
+      out += '\\';
+    }
+    out += *str;
+  }
+}
+
+std::string HeapProfiler::dump(DumpFormat format) {
+  std::lock_guard<std::mutex> guard(_profiler_mutex);
+  const bool json = format == DumpFormat::json;
+  size_t order[SQRL_PROFILER_SITE_NUM];
+  size_t number = 0;
+  for (size_t i = 0; i < SQRL_PROFILER_SITE_NUM; i++) {
+    if (_sites[i].depth == 0) {
+      continue;
+    }
+    // insertion sort, most live bytes first
+    size_t j = number++;
+    while (j > 0 && _sites[order[j - 1]].live_bytes < _sites[i].live_bytes) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+  std::string out;
+  char line[256];
+  snprintf(line, sizeof(line),
+           json ? "{\"sample_rate\": %zu, \"dropped\": %zu, \"sites\": ["
+                : "heap profile: sample rate %zu bytes, %zu samples dropped\n",
+           _sample_rate.load(), _dropped);
+  out += line;
+  for (size_t i = 0; i < number; i++) {
+    const ProfileSite &site = _sites[order[i]];
+    snprintf(line, sizeof(line),
+             json ? "%s{\"samples\": %zu, \"bytes\": %zu, \"live_samples\": "
+                    "%zu, \"live_bytes\": %zu, \"stack\": ["
+                  : "%s\nsamples %zu bytes %zu live samples %zu live bytes "
+                    "%zu\n",
+             json && i != 0 ? ", " : "", site.samples, site.bytes,
+             site.live_samples, site.live_bytes);
+    out += line;
+    char **symbols = backtrace_symbols(site.stack, site.depth);
+    for (int j = 0; j < site.depth; j++) {
+      out += json ? (j != 0 ? ", \"" : "\"") : "    ";
+      if (symbols != nullptr) {
+        _append_escaped(out, symbols[j]);
+      } else {
+        snprintf(line, sizeof(line), "%p", site.stack[j]);
+        out += line;
+      }
+      out += json ? "\"" : "\n";
+    }
+    free(symbols);
+    out += json ? "]}" : "";
+  }
+  out += json ? "]}" : "";
+  return out;
+}
+
+}; // namespace sqrl
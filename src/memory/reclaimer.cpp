@@ -2,13 +2,66 @@
 
 namespace sqrl {
 
-namespace {
-static Block *_head = _block_head;
-static Block *_top = _block_top;
-static size_t _allocated = _block_allocated;
+Reclaimer::Reclaimer(size_t step_size, size_t purge_size, size_t top_pad,
+                     size_t cache_age)
+    : step_size(step_size), purge_size(purge_size), top_pad(top_pad),
+      cache_age(cache_age), trimmed(0), purged(0), worker(nullptr), running(false) {}
 
-}; // anonymous namespace
+Reclaimer::~Reclaimer() { stop(); }
 
-void Reclaimer::run() {}
+bool Reclaimer::step() {
+  std::lock_guard<std::mutex> guard(manager.mutex());
+  manager.free_remote();
+  size_t purged_before = manager.purged_size();
+  bool done = manager.compact(step_size, purge_size);
+  purged += manager.purged_size() - purged_before;
+  if (done) {
+    trimmed += manager.trim(top_pad) + manager.release_mmap_cache(cache_age);
+  }
+  return done;
+}
 
-}; // namespace sqrl
\ No newline at end of file
+void Reclaimer::run() {
+  ThreadCache::local().flush();
+  while (!step()) {
+  }
+}
+
+void Reclaimer::start(std::chrono::milliseconds interval) {
+  std::unique_lock<std::mutex> guard(lock);
+  if (running) {
+    return;
+  }
+  running = true;
+  worker = new sqrl::Thread([this, interval]() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (running) {
+      // heap is not held while waiting for next pass
+      guard.unlock();
+      while (!step()) {
+      }
+      guard.lock();
+      condition.wait_for(guard, interval, [this]() { return !running; });
+    }
+  });
+}
+
+void Reclaimer::stop() {
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    if (!running) {
+      return;
+    }
+    running = false;
+  }
+  condition.notify_all();
+  worker->join();
+  delete worker;
+  worker = nullptr;
+}
+
+size_t Reclaimer::trimmed_size() { return trimmed; }
+
+size_t Reclaimer::purged_size() { return purged; }
+
+}; // namespace sqrl
@@ -1,52 +1,190 @@
 #include <thread/threadpool.h>
 
+#include <container/mpsc_queue.h>
+#include <container/work_stealing_deque.h>
+
+// tasks a worker takes from an inbox at once
+#define SQRL_THREADPOOL_INBOX_BATCH 32
+
 namespace sqrl {
 
+struct ThreadPool::Worker {
+  Worker(ThreadPool *pool, uint64_t random) : pool(pool), random(random) {}
+
+  ThreadPool *pool;
+  sqrl::WorkStealingDeque<Task *> deque;
+  sqrl::Inbox<Task *> inbox;
+  // inbox has one consumer at a time, whoever holds it
+  std::atomic_flag draining = ATOMIC_FLAG_INIT;
+  sqrl::Thread *thread = nullptr;
+  // state of xorshift choosing victims
+  uint64_t random;
+};
+
+thread_local ThreadPool::Worker *ThreadPool::current = nullptr;
+
+static sqrl::Allocator<ThreadPool::Task> _task_allocator;
+
+static void _release_task(ThreadPool::Task *task) {
+  destroy_at(task);
+  _task_allocator.deallocate(task, 1);
+}
+
+// nothing if someone else is taking from the inbox
+ThreadPool::Task *ThreadPool::take_inbox(Worker *victim, Worker *self) {
+  if (victim->draining.test_and_set(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  Task *tasks[SQRL_THREADPOOL_INBOX_BATCH];
+  // a thread out of the pool has no deque for the rest
+  size_t n = victim->inbox.drain(
+      tasks, self != nullptr ? SQRL_THREADPOOL_INBOX_BATCH : 1);
+  victim->draining.clear(std::memory_order_release);
+  if (n == 0) {
+    return nullptr;
+  }
+  // oldest one first, the rest are popped latest first or stolen oldest
+  // first
+  for (size_t i = n - 1; i > 0; i--) {
+    self->deque.push(tasks[i]);
+  }
+  return tasks[0];
+}
+
+// tasks are dealt to workers by index, a pool has one at least
+static int _valid_pool_size(int pool_size) {
+  return pool_size < 1 ? 1 : pool_size;
+}
+
 ThreadPool::ThreadPool(int pool_size)
-    : pool_size(pool_size), workers(pool_size) {
-  handled_tasks_num = 0;
+    : workers(_valid_pool_size(pool_size)), begin(false),
+      handled_tasks_num(0), pool_size(_valid_pool_size(pool_size)),
+      next_inbox(0), signals(0), sleeping(0) {
+  for (int i = 0; i < this->pool_size; i++) {
+    workers.emplace_back(new Worker(this, i + 1));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  if (begin) {
+    stop();
+  }
+  for (auto itr = workers.cbegin(); itr != workers.cend(); itr++) {
+    // tasks never run if pool never started
+    Task *task;
+    while ((*itr)->deque.pop(task) || (*itr)->inbox.try_pop(task)) {
+      _release_task(task);
+    }
+    delete *itr;
+  }
 }
 
 void ThreadPool::start() {
   begin = true;
-  for (int i = 0; i < pool_size; i++) {
-    workers.emplace_back(new sqrl::Thread([this]() {
-      while (true) {
-        Task task;
-        // critical area, need lock for thread safe
-        {
-          std::unique_lock<std::mutex> guard(lock);
-          // release the lock and wait till condition meet
-          this->condition.wait(
-              guard, [this]() { return !this->begin || !this->tasks.empty(); });
-          // finished waiting and acquire the lock again
-          if (!this->begin && this->tasks.empty()) {
-            return;
-          }
-          if (this->tasks.empty()) {
-            guard.unlock();
-            continue;
-          }
-          task = this->tasks.front();
-          this->tasks.pop();
-          this->handled_tasks_num++;
-          task();
-        }
-      }
-    }));
+  for (auto itr = workers.cbegin(); itr != workers.cend(); itr++) {
+    Worker *worker = *itr;
+    worker->thread = new sqrl::Thread([this, worker]() { work(worker); });
   }
 }
 
 void ThreadPool::stop() {
   {
     std::unique_lock<std::mutex> guard(lock);
+    // never started or stopped already
+    if (!begin) {
+      return;
+    }
     begin = false;
   }
   condition.notify_all();
   for (auto itr = workers.cbegin(); itr != workers.cend(); itr++) {
-    (*itr)->join();
+    if ((*itr)->thread == nullptr) {
+      continue;
+    }
+    (*itr)->thread->join();
+    delete (*itr)->thread;
+    (*itr)->thread = nullptr;
+  }
+}
+
+void ThreadPool::submit(Task &&t) {
+  Task *task = new (_task_allocator.allocate(1)) Task(std::move(t));
+  if (current != nullptr && current->pool == this) {
+    current->deque.push(task);
+  } else {
+    size_t inbox = next_inbox.fetch_add(1, std::memory_order_relaxed);
+    workers[inbox % pool_size]->inbox.push(task);
+  }
+  // a worker parks only if it saw no signal after it counted itself
+  // sleeping, see work()
+  signals.fetch_add(1, std::memory_order_seq_cst);
+  if (sleeping.load(std::memory_order_seq_cst) > 0) {
+    std::unique_lock<std::mutex> guard(lock);
+    condition.notify_one();
+  }
+}
+
+bool ThreadPool::run_one(Worker *self) {
+  if (self != nullptr && self->pool != this) {
+    // worker of another pool only steals here
+    self = nullptr;
+  }
+  Task *task = nullptr;
+  if (self != nullptr && !self->deque.pop(task)) {
+    task = take_inbox(self, self);
+  }
+  if (task == nullptr) {
+    uint64_t random = self != nullptr ? self->random : (uintptr_t)&task;
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    if (self != nullptr) {
+      self->random = random;
+    }
+    for (int i = 0; i < pool_size && task == nullptr; i++) {
+      Worker *victim = workers[(random + i) % pool_size];
+      if (victim == self) {
+        continue;
+      }
+      if (!victim->deque.steal(task)) {
+        task = take_inbox(victim, self);
+      }
+    }
+  }
+  if (task == nullptr) {
+    return false;
+  }
+  (*task)();
+  _release_task(task);
+  handled_tasks_num.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void ThreadPool::work(Worker *self) {
+  current = self;
+  while (true) {
+    if (run_one(self)) {
+      continue;
+    }
+    if (!begin) {
+      // nothing left to run anywhere
+      return;
+    }
+    sleeping.fetch_add(1, std::memory_order_seq_cst);
+    size_t seen = signals.load(std::memory_order_seq_cst);
+    // a task enqueued before it counted itself sleeping is found here
+    if (run_one(self)) {
+      sleeping.fetch_sub(1, std::memory_order_relaxed);
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      condition.wait(guard, [this, seen]() {
+        return signals.load(std::memory_order_seq_cst) != seen || !begin;
+      });
+    }
+    sleeping.fetch_sub(1, std::memory_order_relaxed);
   }
-  workers.clear();
 }
 
-}; // namespace sqrl
\ No newline at end of file
+}; // namespace sqrl
@@ -0,0 +1,77 @@
+#include <container/queue.h>
+#include <container/vector.h>
+#include <gtest/gtest.h>
+#include <memory/arena.h>
+#include <string/string.h>
+
+using namespace sqrl;
+
+TEST(arena_test, allocate_aligned_and_apart) {
+  MonotonicArena arena;
+  word_t *first = arena.allocate(3);
+  word_t *second = arena.allocate(100);
+  EXPECT_EQ((uintptr_t)first % alignof(std::max_align_t), 0);
+  EXPECT_EQ((uintptr_t)second % alignof(std::max_align_t), 0);
+  EXPECT_GE((char *)second, (char *)first + 3);
+  EXPECT_EQ(arena.allocated_size(), 103);
+}
+
+TEST(arena_test, allocate_over_aligned_objects) {
+  struct alignas(128) Wide {
+    char data[40];
+  };
+  MonotonicArena arena;
+  ArenaAllocator<Wide> allocator(arena);
+  arena.allocate(3);
+  for (int i = 0; i < 100; i++) {
+    Wide *wide = allocator.allocate(1);
+    EXPECT_EQ((uintptr_t)wide % alignof(Wide), 0);
+  }
+  EXPECT_EQ((uintptr_t)arena.allocate_aligned(10, 4096) % 4096, 0);
+}
+
+TEST(arena_test, start_from_buffer) {
+  alignas(std::max_align_t) char buffer[256];
+  MonotonicArena arena(buffer, sizeof(buffer));
+  char *data = (char *)arena.allocate(100);
+  EXPECT_EQ(data, buffer);
+  // buffer is not enough, an upstream chunk is chained
+  char *chunk = (char *)arena.allocate(200);
+  EXPECT_TRUE(chunk < buffer || chunk >= buffer + sizeof(buffer));
+  arena.reset();
+  EXPECT_EQ((char *)arena.allocate(100), buffer);
+}
+
+TEST(arena_test, reset_reuse_chunks) {
+  MonotonicArena arena(1024);
+  char *first = (char *)arena.allocate(512);
+  arena.allocate(800);
+  // larger than a chunk
+  arena.allocate(4096);
+  arena.reset();
+  EXPECT_EQ(arena.allocated_size(), 0);
+  EXPECT_EQ((char *)arena.allocate(512), first);
+}
+
+TEST(arena_test, containers_on_arena) {
+  MonotonicArena &arena = MonotonicArena::local();
+  {
+    Vector<int, ArenaAllocator<int>> v;
+    for (int i = 0; i < 1000; i++) {
+      v.push_back(i);
+    }
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_EQ(v[i], i);
+    }
+    Queue<int, ArenaAllocator<int>> q(10);
+    q.push(1);
+    q.push(2);
+    EXPECT_EQ(q.front(), 1);
+    BasicString<ArenaAllocator<char>> s("abc");
+    BasicString<ArenaAllocator<char>> ss = s + s;
+    EXPECT_TRUE(_strcmp(ss.c_str(), "abcabc"));
+  }
+  EXPECT_GT(arena.allocated_size(), 1000 * sizeof(int));
+  arena.reset();
+  EXPECT_EQ(arena.allocated_size(), 0);
+}
@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <memory/_allocator_impl.h>
 #include <memory/allocator.h>
+#include <thread>
+#include <vector>
 
 using namespace sqrl;
 class TestObj {
@@ -15,6 +18,14 @@ static Allocator<TestObj> obj_allocator;
 static BlockViewer viewer;
 static BlockManager manager;
 
+static size_t count_blocks() {
+  size_t number = 0;
+  for (auto itr = viewer.get_head(); !itr.null(); itr.next()) {
+    number++;
+  }
+  return number;
+}
+
 class MemoryAllocatorTest : public ::testing::Test {
 protected:
   void SetUp() {
@@ -40,6 +51,10 @@ TEST_F(MemoryAllocatorTest, alloc_block) {
   ASSERT_EQ(block->next, nullptr);
   obj_allocator.deallocate(data, 1);
   ASSERT_EQ(viewer.memory_size(), 0);
+  // released block is kept by quarantine of hardened mode and thread cache
+  // till they are flushed
+  manager.flush_quarantine();
+  ThreadCache::local().flush();
   EXPECT_FALSE(used(block));
 }
 
@@ -47,7 +62,9 @@ TEST_F(MemoryAllocatorTest, reuse_block) {
   auto data = obj_allocator.allocate(1);
   Block *block = get_block((word_t *)data);
   obj_allocator.deallocate(data, 1);
-  EXPECT_FALSE(used(block));
+  manager.flush_quarantine();
+  // thread cache keeps the block for the next allocation of same size
+  EXPECT_TRUE(used(block));
 
   data = obj_allocator.allocate(1);
   Block *block2 = get_block((word_t *)data);
@@ -55,15 +72,73 @@ TEST_F(MemoryAllocatorTest, reuse_block) {
   EXPECT_TRUE(used(block));
 }
 
-TEST_F(MemoryAllocatorTest, find_free_block_skip_too_large_block) {
-  auto data = obj_allocator.allocate(3);
-  EXPECT_EQ(viewer.memory_size(), alloc_size(sizeof(TestObj) * 3));
-  obj_allocator.deallocate(data, 3);
-  EXPECT_EQ(viewer.memory_size(), 0);
-  data = obj_allocator.allocate(1);
-  // allocator should create another block
-  EXPECT_EQ(viewer.block_number(), 2);
-  EXPECT_EQ(viewer.memory_size(), alloc_size(sizeof(TestObj)));
+TEST_F(MemoryAllocatorTest, split_too_large_block) {
+  // keep the block away from released blocks of previous tests
+  TestObj *guard = obj_allocator.allocate(40);
+  auto data = obj_allocator.allocate(100);
+  Block *large_block = get_block((word_t *)data);
+  // a released rest left before it by the guard merges with it
+  Block *front = get_prev_free(large_block);
+  size_t large_size = get_size(large_block);
+  if (front != nullptr) {
+    large_size += get_size(front);
+    large_block = front;
+  }
+  obj_allocator.deallocate(data, 100);
+  manager.flush_quarantine();
+  data = obj_allocator.allocate(40);
+  // allocator should only take the part it needs from the large block
+  ASSERT_EQ(get_block((word_t *)data), large_block);
+  EXPECT_EQ(get_size(large_block), alloc_size(sizeof(TestObj) * 40));
+  Block *rest = large_block->next;
+  EXPECT_FALSE(used(rest));
+  EXPECT_EQ(get_size(rest), large_size - alloc_size(sizeof(TestObj) * 40));
+  obj_allocator.deallocate(data, 40);
+  manager.flush_quarantine();
+  // both parts merge again
+  EXPECT_GE(get_size(large_block), alloc_size(sizeof(TestObj) * 100));
+  obj_allocator.deallocate(guard, 40);
+}
+
+TEST_F(MemoryAllocatorTest, coalesce_released_neighbours) {
+  TestObj *front = obj_allocator.allocate(40);
+  TestObj *a = obj_allocator.allocate(40);
+  TestObj *b = obj_allocator.allocate(40);
+  TestObj *c = obj_allocator.allocate(40);
+  TestObj *guard = obj_allocator.allocate(40);
+  Block *block_a = get_block((word_t *)a);
+  Block *block_c = get_block((word_t *)c);
+  obj_allocator.deallocate(a, 40);
+  obj_allocator.deallocate(c, 40);
+  // merge with both previous and next block
+  obj_allocator.deallocate(b, 40);
+  manager.flush_quarantine();
+  EXPECT_FALSE(used(block_a));
+  EXPECT_GE(get_size(block_a), alloc_size(sizeof(TestObj) * 40) * 3);
+  EXPECT_GE((char *)block_a + get_size(block_a),
+            (char *)block_c + alloc_size(sizeof(TestObj) * 40));
+  TestObj *data = obj_allocator.allocate(100);
+  EXPECT_EQ(get_block((word_t *)data), block_a);
+  obj_allocator.deallocate(data, 100);
+  obj_allocator.deallocate(guard, 40);
+  obj_allocator.deallocate(front, 40);
+}
+
+TEST_F(MemoryAllocatorTest, reuse_block_from_size_class) {
+  TestObj *small = obj_allocator.allocate(1);
+  TestObj *medium = obj_allocator.allocate(5);
+  TestObj *large = obj_allocator.allocate(40);
+  Block *medium_block = get_block((word_t *)medium);
+  Block *large_block = get_block((word_t *)large);
+  obj_allocator.deallocate(large, 40);
+  obj_allocator.deallocate(medium, 5);
+  manager.flush_quarantine();
+  // released blocks are found by their size class, not by position
+  TestObj *data = obj_allocator.allocate(40);
+  EXPECT_EQ(get_block((word_t *)data), large_block);
+  data = obj_allocator.allocate(5);
+  EXPECT_EQ(get_block((word_t *)data), medium_block);
+  obj_allocator.deallocate(small, 1);
 }
 
 TEST_F(MemoryAllocatorTest, all_allocators_share_state) {
@@ -83,6 +158,9 @@ TEST_F(MemoryAllocatorTest, allocate_a_list_of_objects) {
 }
 
 TEST_F(MemoryAllocatorTest, allocate_large_block) {
+#ifdef SQRL_HARDENED
+  GTEST_SKIP() << "guarded large blocks are never cached";
+#endif
   size_t request_size_before = viewer.memory_requested_size();
   size_t size = 1024 * 2048;
   TestObj *ptr = obj_allocator.allocate(size);
@@ -92,6 +170,362 @@ TEST_F(MemoryAllocatorTest, allocate_large_block) {
   ASSERT_EQ(viewer.memory_size(), alloc_size(size * sizeof(TestObj)));
   obj_allocator.deallocate(ptr, size);
   ASSERT_EQ(viewer.memory_size(), 0);
+  // kept for reuse till the cache is released
+  EXPECT_EQ(viewer.stats().mmap_cache_size, alloc_size(size * sizeof(TestObj)));
+  {
+    std::lock_guard<std::mutex> guard(manager.mutex());
+    manager.release_mmap_cache();
+  }
   // validate memory release back to OS
   ASSERT_EQ(viewer.memory_requested_size(), request_size_before);
-}
\ No newline at end of file
+}
+TEST_F(MemoryAllocatorTest, reuse_cached_large_block) {
+#ifdef SQRL_HARDENED
+  GTEST_SKIP() << "guarded large blocks are never cached";
+#endif
+  GenericAllocator allocator;
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 4;
+  manager.set_mmap_threshold(SQRL_ALLOCATOR_MMAP_THRESHOLD);
+  word_t *data = allocator.allocate(size);
+  Block *block = get_block(data);
+  allocator.deallocate(data, size);
+  EXPECT_EQ(viewer.stats().mmap_cache_size, alloc_size(size));
+  size_t requested = viewer.memory_requested_size();
+  // a little smaller one takes the same mapping
+  data = allocator.allocate(size - 1024);
+  EXPECT_EQ(get_block(data), block);
+  EXPECT_EQ(viewer.stats().mmap_cache_size, 0);
+  EXPECT_EQ(viewer.memory_requested_size(), requested);
+  allocator.deallocate(data, size - 1024);
+  // a larger one grows it
+  data = allocator.allocate(size * 2);
+  EXPECT_EQ(get_size(get_block(data)), alloc_size(size * 2));
+  EXPECT_EQ(viewer.memory_requested_size(), requested + alloc_size(size * 2) -
+                                                alloc_size(size));
+  ((char *)data)[size * 2 - 1] = 1;
+  allocator.deallocate(data, size * 2);
+  EXPECT_EQ(viewer.memory_size(), 0);
+}
+
+TEST_F(MemoryAllocatorTest, release_cached_large_block_twice) {
+#ifdef SQRL_HARDENED
+  GTEST_SKIP() << "releasing a block twice aborts";
+#endif
+  GenericAllocator allocator;
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 4;
+  manager.set_mmap_threshold(SQRL_ALLOCATOR_MMAP_THRESHOLD);
+  word_t *data = allocator.allocate(size);
+  size_t used = viewer.memory_used_size();
+  allocator.deallocate(data, size);
+  allocator.deallocate(data, size);
+  AllocatorStats stats = viewer.stats();
+  // cached once, two requests never take the same mapping
+  EXPECT_EQ(stats.mmap_cache_size, alloc_size(size));
+  EXPECT_EQ(stats.used_size, used - alloc_size(size));
+  word_t *first = allocator.allocate(size);
+  word_t *second = allocator.allocate(size);
+  EXPECT_NE(first, second);
+  allocator.deallocate(first, size);
+  allocator.deallocate(second, size);
+}
+
+TEST_F(MemoryAllocatorTest, raise_mmap_threshold) {
+  GenericAllocator allocator;
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 2;
+  word_t *data = allocator.allocate(size);
+  EXPECT_TRUE(mmapped(get_block(data)));
+  allocator.deallocate(data, size);
+  EXPECT_GT(manager.mmap_threshold(), alloc_size(size));
+#ifndef SQRL_HARDENED
+  // the mapping raising the threshold is still kept
+  EXPECT_EQ(viewer.stats().mmap_cache_size, alloc_size(size));
+  data = allocator.allocate(size * 2);
+  EXPECT_EQ(viewer.stats().mmap_cache_size, 0);
+  allocator.deallocate(data, size * 2);
+  manager.release_mmap_cache();
+#endif
+  // new blocks of the same size come from the heap afterwards
+  data = allocator.allocate(size);
+  EXPECT_FALSE(mmapped(get_block(data)));
+  allocator.deallocate(data, size);
+  // never above the max
+  size = SQRL_ALLOCATOR_MMAP_THRESHOLD_MAX;
+  data = allocator.allocate(size);
+  allocator.deallocate(data, size);
+  EXPECT_LE(manager.mmap_threshold(), SQRL_ALLOCATOR_MMAP_THRESHOLD_MAX);
+}
+
+TEST_F(MemoryAllocatorTest, recycle_large_block_after_raising_threshold) {
+#ifdef SQRL_HARDENED
+  GTEST_SKIP() << "guarded large blocks are never cached";
+#endif
+  GenericAllocator allocator;
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 2;
+  word_t *data = allocator.allocate(size);
+  Block *block = get_block(data);
+  allocator.deallocate(data, size);
+  EXPECT_GT(manager.mmap_threshold(), alloc_size(size));
+  size_t requested = viewer.memory_requested_size();
+  // a buffer of the same size is served by the cached mapping, again and
+  // again
+  for (int i = 0; i < 3; i++) {
+    data = allocator.allocate(size);
+    EXPECT_EQ(get_block(data), block);
+    EXPECT_EQ(viewer.stats().mmap_cache_size, 0);
+    EXPECT_EQ(viewer.memory_requested_size(), requested);
+    allocator.deallocate(data, size);
+    EXPECT_EQ(viewer.stats().mmap_cache_size, alloc_size(size));
+  }
+  manager.release_mmap_cache();
+}
+
+TEST_F(MemoryAllocatorTest, reallocate_in_place) {
+  GenericAllocator allocator;
+  word_t *data = allocator.allocate(1024);
+  word_t *next = allocator.allocate(1024);
+  word_t *guard = allocator.allocate(1024);
+  memset(data, 7, 1024);
+  allocator.deallocate(next, 1024);
+  manager.flush_quarantine();
+  // grow into the released next block
+  word_t *grown = allocator.reallocate(data, 1500);
+  EXPECT_EQ(grown, data);
+  data = grown;
+  EXPECT_GE(get_size(get_block(data)), alloc_size(1500));
+  EXPECT_EQ(((char *)data)[1023], 7);
+  // the rest of the next block goes back to a bin
+  EXPECT_EQ(viewer.memory_size(), alloc_size(1500) + alloc_size(1024));
+  // shrink gives the rest back
+  word_t *shrunk = allocator.reallocate(data, 600);
+  EXPECT_EQ(shrunk, data);
+  data = shrunk;
+  EXPECT_EQ(get_size(get_block(data)), alloc_size(600));
+  EXPECT_EQ(((char *)data)[599], 7);
+  EXPECT_EQ(viewer.memory_size(), alloc_size(600) + alloc_size(1024));
+  // no room after it, moved to a new block
+  word_t *moved = allocator.reallocate(data, 8192);
+  EXPECT_NE(moved, data);
+  EXPECT_EQ(((char *)moved)[599], 7);
+  allocator.deallocate(moved, 8192);
+  allocator.deallocate(guard, 1024);
+  EXPECT_EQ(viewer.memory_size(), 0);
+  EXPECT_EQ(viewer.block_number(), count_blocks());
+}
+
+TEST_F(MemoryAllocatorTest, reallocate_top_of_heap) {
+  GenericAllocator allocator;
+  size_t size = 4 << 20;
+  // larger than any released block, it comes from a new arena with room
+  // left after it
+  manager.set_mmap_threshold(SQRL_ALLOCATOR_MMAP_THRESHOLD_MAX);
+  set_arena_size(4 * size);
+  word_t *data = allocator.allocate(size);
+  set_arena_size(SQRL_BLOCK_ARENA_SIZE);
+  if ((char *)get_block(data) + get_size(get_block(data)) != heap_end()) {
+    GTEST_SKIP() << "block is not at the top of the heap";
+  }
+  size_t requested = viewer.memory_requested_size();
+  ((char *)data)[size - 1] = 1;
+  // heap grows right after it
+  EXPECT_EQ(allocator.reallocate(data, size * 2), data);
+  EXPECT_EQ(((char *)data)[size - 1], 1);
+  EXPECT_EQ(viewer.memory_requested_size(),
+            requested + alloc_size(size * 2) - alloc_size(size));
+  allocator.deallocate(data, size * 2);
+  EXPECT_EQ(viewer.memory_size(), 0);
+}
+
+TEST_F(MemoryAllocatorTest, reallocate_large_block) {
+  GenericAllocator allocator;
+  manager.set_mmap_threshold(SQRL_ALLOCATOR_MMAP_THRESHOLD);
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 2;
+  word_t *data = allocator.reallocate(nullptr, size);
+  EXPECT_TRUE(mmapped(get_block(data)));
+  ((char *)data)[size - 1] = 3;
+  data = allocator.reallocate(data, size * 8);
+  EXPECT_TRUE(mmapped(get_block(data)));
+  EXPECT_EQ(((char *)data)[size - 1], 3);
+  EXPECT_EQ(viewer.memory_size(), alloc_size(size * 8));
+  // small enough to come from the heap
+  data = allocator.reallocate(data, 1024);
+  EXPECT_FALSE(mmapped(get_block(data)));
+  EXPECT_EQ(((char *)data)[1023], 0);
+  allocator.deallocate(data, 1024);
+  EXPECT_EQ(viewer.memory_size(), 0);
+}
+
+TEST_F(MemoryAllocatorTest, thread_cache_flush_on_thread_exit) {
+  std::thread worker([]() {
+    auto data = obj_allocator.allocate(1);
+    obj_allocator.deallocate(data, 1);
+    EXPECT_NE(ThreadCache::local().cached_size(), 0);
+  });
+  worker.join();
+  ASSERT_EQ(ThreadCache::total_cached_size(),
+            ThreadCache::local().cached_size());
+  ASSERT_EQ(viewer.memory_size(), 0);
+}
+
+TEST_F(MemoryAllocatorTest, allocate_from_many_threads) {
+  const size_t thread_num = 16;
+  const size_t loop_num = 1000;
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < thread_num; t++) {
+    workers.emplace_back([t, loop_num]() {
+      std::vector<TestObj *> objs;
+      for (size_t i = 0; i < loop_num; i++) {
+        TestObj *obj = obj_allocator.allocate(1 + i % 8);
+        obj->x = t;
+        obj->y = i;
+        objs.push_back(obj);
+      }
+      for (size_t i = 0; i < loop_num; i++) {
+        EXPECT_EQ(objs[i]->x, t);
+        EXPECT_EQ(objs[i]->y, i);
+        obj_allocator.deallocate(objs[i], 1 + i % 8);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  ASSERT_EQ(viewer.memory_size(), 0);
+}
+
+TEST_F(MemoryAllocatorTest, deallocate_from_another_thread) {
+  std::vector<TestObj *> objs;
+  for (size_t i = 0; i < 100; i++) {
+    objs.push_back(obj_allocator.allocate(1 + i % 4));
+  }
+  std::thread worker([&objs]() {
+    for (auto obj : objs) {
+      obj_allocator.deallocate(obj, 1);
+    }
+  });
+  worker.join();
+  ASSERT_EQ(viewer.memory_size(), 0);
+}
+
+TEST_F(MemoryAllocatorTest, pass_blocks_between_threads_without_lock) {
+  GenericAllocator allocator;
+  std::vector<word_t *> small;
+  std::vector<word_t *> large;
+  for (int i = 0; i < 4; i++) {
+    large.push_back(allocator.allocate(4096));
+  }
+  word_t *taken[64];
+  std::atomic<int> ready{0};
+  std::atomic<int> stage{0};
+  auto wait = [&stage](int value) {
+    while (stage.load() != value) {
+      std::this_thread::yield();
+    }
+  };
+  std::thread consumer([&]() {
+    // thread cache registers itself under central heap lock
+    ThreadCache::local();
+    ready++;
+    wait(1);
+    for (auto data : small) {
+      allocator.deallocate(data, 64);
+    }
+    for (auto data : large) {
+      allocator.deallocate(data, 4096);
+    }
+    stage = 2;
+  });
+  std::thread producer([&]() {
+    // whole batches, nothing is left in the magazine
+    for (int i = 0; i < 8 * SQRL_ALLOCATOR_TCACHE_BATCH; i++) {
+      small.push_back(allocator.allocate(64));
+    }
+    EXPECT_EQ(ThreadCache::local().cached_size(), 0);
+    ready++;
+    wait(2);
+    // blocks released by consumer come back to their owner
+    for (int i = 0; i < 64; i++) {
+      taken[i] = allocator.allocate(64);
+    }
+    stage = 3;
+  });
+  while (ready.load() != 2) {
+    std::this_thread::yield();
+  }
+  {
+    // neither thread waits for central heap
+    std::lock_guard<std::mutex> guard(manager.mutex());
+    stage = 1;
+    wait(3);
+  }
+  consumer.join();
+  producer.join();
+  for (int i = 0; i < 64; i++) {
+    EXPECT_NE(std::find(small.begin(), small.end(), taken[i]), small.end());
+  }
+  // large blocks released while heap is held are freed by the next holder
+  EXPECT_EQ(viewer.memory_size(), 64 * alloc_size(64));
+  for (int i = 0; i < 64; i++) {
+    allocator.deallocate(taken[i], 64);
+  }
+  ThreadCache::local().flush();
+  EXPECT_EQ(viewer.memory_size(), 0);
+}
+
+struct alignas(64) CacheLineObj {
+  int x;
+};
+
+TEST_F(MemoryAllocatorTest, allocate_aligned) {
+  GenericAllocator allocator;
+  for (size_t alignment = 16; alignment <= 4096; alignment *= 2) {
+    word_t *data = allocator.allocate_aligned(100, alignment);
+    EXPECT_EQ((uintptr_t)data % alignment, 0);
+    // the front and the rest go back to bins, only data is used
+    EXPECT_EQ(viewer.memory_size(), alloc_size(100));
+    allocator.deallocate(data, 100);
+    ThreadCache::local().flush();
+    EXPECT_EQ(viewer.memory_size(), 0);
+  }
+}
+
+TEST_F(MemoryAllocatorTest, allocate_aligned_large_block) {
+  GenericAllocator allocator;
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 2;
+  word_t *data = allocator.allocate_aligned(size, 8192);
+  EXPECT_EQ((uintptr_t)data % 8192, 0);
+  EXPECT_TRUE(mmapped(get_block(data)));
+  EXPECT_GE(get_size(get_block(data)), alloc_size(size));
+  allocator.deallocate(data, size);
+  EXPECT_EQ(viewer.memory_size(), 0);
+}
+
+TEST_F(MemoryAllocatorTest, allocate_aligned_out_of_memory) {
+  if (get_block_backend() != SQRL_BLOCK_BACKEND_ARENA) {
+    GTEST_SKIP();
+  }
+  GenericAllocator allocator;
+  // no arena can be mapped any more, the current one runs out
+  set_arena_size((size_t)1 << 62);
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD / 2;
+  std::vector<word_t *> blocks;
+  while (word_t *data = allocator.allocate(size)) {
+    blocks.push_back(data);
+  }
+  EXPECT_EQ(allocator.allocate_aligned(size, 4096), nullptr);
+  set_arena_size(SQRL_BLOCK_ARENA_SIZE);
+  for (word_t *data : blocks) {
+    allocator.deallocate(data, size);
+  }
+}
+
+TEST_F(MemoryAllocatorTest, allocate_over_aligned_object) {
+  Allocator<CacheLineObj> allocator;
+  CacheLineObj *objs[10];
+  for (int i = 0; i < 10; i++) {
+    objs[i] = allocator.allocate(i + 1);
+    EXPECT_EQ((uintptr_t)objs[i] % alignof(CacheLineObj), 0);
+  }
+  for (int i = 0; i < 10; i++) {
+    allocator.deallocate(objs[i], i + 1);
+  }
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <memory/_block.h>
+#include <unistd.h>
 
 #define SQRL_ALLOCATOR_MMAP_THRESHOLD 131072
 
@@ -30,6 +31,30 @@ TEST(memory_block_test, request_from_os) {
   release_block(block);
 }
 
+TEST(memory_block_test, request_from_arena) {
+  set_block_backend(SQRL_BLOCK_BACKEND_ARENA);
+  Block *first = request_block_from_os(sizeof(TestObj));
+  Block *second = request_block_from_os(sizeof(TestObj));
+  // carved one after another from the same arena
+  ASSERT_EQ((char *)second, (char *)first + get_size(first));
+  ASSERT_EQ(heap_end(), (char *)second + get_size(second));
+  // too large for the rest of the arena, a new one is mapped
+  Block *large = request_block_from_os(SQRL_BLOCK_ARENA_SIZE);
+  ASSERT_TRUE(large != NULL);
+  ASSERT_EQ(get_size(large), alloc_size(SQRL_BLOCK_ARENA_SIZE));
+  ASSERT_EQ(heap_end(), (char *)large + get_size(large));
+  set_block_backend(SQRL_BLOCK_DEFAULT_BACKEND);
+}
+
+TEST(memory_block_test, request_from_sbrk) {
+  set_block_backend(SQRL_BLOCK_BACKEND_SBRK);
+  Block *block = request_block_from_os(sizeof(TestObj));
+  ASSERT_TRUE(block != NULL);
+  ASSERT_EQ(heap_end(), sbrk(0));
+  ASSERT_EQ(heap_end(), (char *)block + get_size(block));
+  set_block_backend(SQRL_BLOCK_DEFAULT_BACKEND);
+}
+
 TEST(memory_block_test, request_large_block_from_os) {
   Block *block = request_large_block_from_os(sizeof(TestObj));
   // early stop the test if fail
@@ -48,21 +73,48 @@ TEST(memory_block_test, request_large_block_from_os) {
   ASSERT_EQ(release_large_block_to_os(block), 0);
 }
 
+TEST(memory_block_test, request_huge_page_block_from_os) {
+  set_huge_page(true);
+  // smaller than a huge page is mapped by plain pages
+  Block *small = request_large_block_from_os(SQRL_ALLOCATOR_MMAP_THRESHOLD);
+  ASSERT_TRUE(small != NULL);
+  EXPECT_FALSE(huge_page(small));
+  Block *block = request_large_block_from_os(SQRL_BLOCK_HUGE_PAGE_SIZE);
+  set_huge_page(false);
+  ASSERT_TRUE(block != NULL);
+  EXPECT_TRUE(huge_page(block));
+  EXPECT_TRUE(mmapped(block));
+  EXPECT_EQ((uintptr_t)block % SQRL_BLOCK_HUGE_PAGE_SIZE, 0);
+  // rounded up to huge pages
+  EXPECT_EQ(get_size(block), 2 * SQRL_BLOCK_HUGE_PAGE_SIZE);
+  char *data = (char *)block->data;
+  data[0] = 1;
+  data[SQRL_BLOCK_HUGE_PAGE_SIZE] = 2;
+  EXPECT_EQ(data[0] + data[SQRL_BLOCK_HUGE_PAGE_SIZE], 3);
+  EXPECT_EQ(release_large_block_to_os(block), 0);
+  EXPECT_EQ(release_large_block_to_os(small), 0);
+}
+
 TEST(memory_block_test, split_block) {
-  Block *block = request_block_from_os(sizeof(TestObj) * 4);
+  Block *block = request_block_from_os(sizeof(TestObj) * 5);
   // split will not change used block
   split(block, sizeof(TestObj));
-  ASSERT_EQ(get_size(block), alloc_size(sizeof(TestObj) * 4));
+  ASSERT_EQ(get_size(block), alloc_size(sizeof(TestObj) * 5));
   // split will not change block if with given size larger than block
   used_clear(block);
   split(block, sizeof(TestObj) * 30);
-  ASSERT_EQ(get_size(block), alloc_size(sizeof(TestObj) * 4));
+  ASSERT_EQ(get_size(block), alloc_size(sizeof(TestObj) * 5));
+  // split will not change block if the rest is too small to be a block
+  split(block, sizeof(TestObj) * 4);
+  ASSERT_EQ(get_size(block), alloc_size(sizeof(TestObj) * 5));
 
   split(block, sizeof(TestObj) * 2);
+  ASSERT_EQ(get_size(block), alloc_size(sizeof(TestObj) * 2));
   EXPECT_TRUE(block->next != nullptr);
   EXPECT_FALSE(used(block->next));
-  ASSERT_EQ(get_size(block->next),
-            alloc_size(sizeof(TestObj) * 2) - sizeof(BlockHeader));
+  EXPECT_TRUE(prev_free(block->next));
+  ASSERT_EQ(get_size(block->next), alloc_size(sizeof(TestObj) * 5) -
+                                       alloc_size(sizeof(TestObj) * 2));
 }
 
 TEST(memory_block_test, coalesce_block) {
@@ -71,6 +123,75 @@ TEST(memory_block_test, coalesce_block) {
   used_clear(block);
   used_clear(block2);
   block->next = block2;
-  coalesce_block(block);
+  EXPECT_TRUE(coalesce_block(block));
   ASSERT_EQ(get_size(block), alloc_size(sizeof(TestObj)) * 2);
-}
\ No newline at end of file
+  ASSERT_EQ(block->next, nullptr);
+}
+
+TEST(memory_block_test, boundary_tag) {
+  Block *block = request_block_from_os(sizeof(TestObj));
+  Block *block2 = request_block_from_os(sizeof(TestObj));
+  block->next = block2;
+  ASSERT_TRUE(adjacent(block));
+  EXPECT_EQ(get_prev_free(block2), nullptr);
+  // released block tells its neighbour where it starts
+  release_block(block);
+  EXPECT_TRUE(prev_free(block2));
+  EXPECT_EQ(get_prev_free(block2), block);
+  acquire_block(block);
+  EXPECT_FALSE(prev_free(block2));
+  EXPECT_EQ(get_prev_free(block2), nullptr);
+  // flags are not part of the size
+  EXPECT_EQ(get_size(block), alloc_size(sizeof(TestObj)));
+}
+TEST(memory_block_test, size_class) {
+  // one class per word below the small bin limit
+  ASSERT_EQ(size_class(SQRL_BLOCK_MIN_SIZE), SQRL_BLOCK_MIN_SIZE / word_s);
+  ASSERT_EQ(size_class(SQRL_BLOCK_MIN_SIZE + word_s),
+            size_class(SQRL_BLOCK_MIN_SIZE) + 1);
+  ASSERT_EQ(size_class(SQRL_BLOCK_SMALL_BIN_LIMIT - word_s),
+            SQRL_BLOCK_SMALL_BIN_NUM - 1);
+  // sub classes for each power of two above it
+  ASSERT_EQ(size_class(SQRL_BLOCK_SMALL_BIN_LIMIT), SQRL_BLOCK_SMALL_BIN_NUM);
+  ASSERT_EQ(size_class(SQRL_BLOCK_SMALL_BIN_LIMIT * 5 / 4),
+            SQRL_BLOCK_SMALL_BIN_NUM + 1);
+  ASSERT_EQ(size_class(SQRL_BLOCK_SMALL_BIN_LIMIT * 2),
+            SQRL_BLOCK_SMALL_BIN_NUM + SQRL_BLOCK_BIN_SUB_NUM);
+  ASSERT_LT(size_class(SIZE_MAX), SQRL_BLOCK_BIN_NUM);
+}
+
+TEST(memory_block_test, free_list) {
+  Block *head = nullptr;
+  Block *block = request_block_from_os(sizeof(TestObj));
+  Block *block2 = request_block_from_os(sizeof(TestObj));
+  free_list_push(&head, block);
+  free_list_push(&head, block2);
+  ASSERT_EQ(head, block2);
+  ASSERT_EQ(get_free_links(block2)->next, block);
+  ASSERT_EQ(get_free_links(block)->prev, block2);
+  free_list_remove(&head, block2);
+  ASSERT_EQ(head, block);
+  ASSERT_EQ(get_free_links(block)->prev, nullptr);
+  free_list_remove(&head, block);
+  ASSERT_EQ(head, nullptr);
+}
+
+TEST(memory_block_test, split_at_aligned_offset) {
+  Block *block = request_block_from_os(1024);
+  release_block(block);
+  size_t offset = aligned_offset(block, 256);
+  EXPECT_TRUE(offset == 0 || offset >= SQRL_BLOCK_MIN_SIZE);
+  EXPECT_EQ((uintptr_t)((char *)block->data + offset) % 256, 0);
+  if (offset != 0) {
+    size_t size = get_size(block);
+    Block *aligned = split_at(block, offset);
+    ASSERT_TRUE(aligned != NULL);
+    EXPECT_EQ((uintptr_t)aligned->data % 256, 0);
+    EXPECT_EQ(get_size(block), offset);
+    EXPECT_EQ(get_size(block) + get_size(aligned), size);
+    EXPECT_EQ(block->next, aligned);
+    EXPECT_EQ(get_prev_free(aligned), block);
+  }
+  // too small to be cut
+  EXPECT_TRUE(split_at(block, word_s) == NULL);
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <memory/_allocator_impl.h>
+#include <memory/allocator.h>
+#include <thread>
+
+using namespace sqrl;
+
+static GenericAllocator allocator;
+static BlockViewer viewer;
+static BlockManager manager;
+
+class MemoryHardenedTest : public ::testing::Test {
+protected:
+  void SetUp() {
+#ifndef SQRL_HARDENED
+    GTEST_SKIP() << "built without SQRL_HARDENED";
+#endif
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+  }
+  void TearDown() {
+    manager.clear();
+    ASSERT_EQ(viewer.memory_used_size(), 0);
+    ASSERT_TRUE(viewer.safe_check());
+  }
+};
+
+TEST(memory_poison_test, poison_released_block) {
+  word_t *data = allocator.allocate(600);
+  word_t *guard = allocator.allocate(600);
+  Block *block = get_block(data);
+  poison_block(block);
+  EXPECT_TRUE(poisoned(block));
+  ((char *)data)[300] = 0;
+  EXPECT_FALSE(poisoned(block));
+  allocator.deallocate(data, 600);
+  allocator.deallocate(guard, 600);
+  manager.clear();
+}
+
+TEST_F(MemoryHardenedTest, poison_on_release) {
+  word_t *data = allocator.allocate(600);
+  word_t *guard = allocator.allocate(600);
+  allocator.deallocate(data, 600);
+  if (SQRL_ALLOCATOR_QUARANTINE_NUM == 0) {
+    EXPECT_FALSE(used(get_block(data)));
+  }
+  EXPECT_TRUE(poisoned(get_block(data)));
+  allocator.deallocate(guard, 600);
+}
+
+TEST_F(MemoryHardenedTest, double_free_of_small_block) {
+  word_t *data = allocator.allocate(64);
+  allocator.deallocate(data, 64);
+  EXPECT_DEATH(allocator.deallocate(data, 64), "double free");
+}
+
+TEST_F(MemoryHardenedTest, double_free_of_block_released_by_another_thread) {
+  word_t *data = allocator.allocate(64);
+  // it goes back to thread cache of this thread
+  std::thread([data]() { allocator.deallocate(data, 64); }).join();
+  EXPECT_DEATH(allocator.deallocate(data, 64), "double free");
+  ThreadCache::local().flush();
+}
+
+TEST_F(MemoryHardenedTest, double_free_of_released_block) {
+  word_t *data = allocator.allocate(600);
+  word_t *guard = allocator.allocate(600);
+  allocator.deallocate(data, 600);
+  EXPECT_DEATH(
+      {
+        allocator.deallocate(data, 600);
+        // a quarantined block is caught once it leaves
+        manager.flush_quarantine();
+      },
+      "double free");
+  allocator.deallocate(guard, 600);
+}
+
+TEST_F(MemoryHardenedTest, double_free_of_large_block) {
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 2;
+  word_t *data = allocator.allocate(size);
+  ASSERT_TRUE(mmapped(get_block(data)));
+  allocator.deallocate(data, size);
+  // unmapped instead of cached, its header is gone with the mapping
+  EXPECT_DEATH(allocator.deallocate(data, size), "");
+}
+
+TEST_F(MemoryHardenedTest, overflow_into_next_header) {
+  word_t *data = allocator.allocate(600);
+  word_t *next = allocator.allocate(600);
+  ASSERT_EQ((char *)get_block(data) + get_size(get_block(data)),
+            (char *)get_block(next));
+  EXPECT_DEATH(
+      {
+        memset(data, 0, get_size(get_block(data)));
+        allocator.deallocate(next, 600);
+      },
+      "corrupted block header");
+  allocator.deallocate(data, 600);
+  allocator.deallocate(next, 600);
+}
+
+#ifdef SQRL_HARDENED
+TEST_F(MemoryHardenedTest, safe_check_finds_corrupted_header) {
+  word_t *data = allocator.allocate(600);
+  Block *block = get_block(data);
+  size_t canary = block->canary;
+  block->canary = ~canary;
+  EXPECT_FALSE(viewer.safe_check());
+  block->canary = canary;
+  EXPECT_TRUE(viewer.safe_check());
+  allocator.deallocate(data, 600);
+}
+#endif
+
+TEST_F(MemoryHardenedTest, guard_page_after_large_block) {
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 2;
+  char *data = (char *)allocator.allocate(size);
+  Block *block = get_block((word_t *)data);
+  ASSERT_TRUE(mmapped(block));
+  char *end = (char *)block + get_size(block);
+  // the whole block is usable, the byte after it is not
+  end[-1] = 1;
+  EXPECT_DEATH(end[0] = 1, "");
+  EXPECT_DEATH(((char *)block->next)[0] = 1, "");
+  allocator.deallocate((word_t *)data, size);
+}
+
+TEST_F(MemoryHardenedTest, write_after_free_in_quarantine) {
+  if (SQRL_ALLOCATOR_QUARANTINE_NUM == 0) {
+    GTEST_SKIP() << "built without quarantine";
+  }
+  word_t *data = allocator.allocate(600);
+  allocator.deallocate(data, 600);
+  // held back, nobody else gets it
+  EXPECT_TRUE(used(get_block(data)));
+  EXPECT_DEATH(
+      {
+        ((char *)data)[300] = 0;
+        // pushed out by later releases
+#if SQRL_ALLOCATOR_QUARANTINE_NUM > 0
+        for (size_t i = 0; i < SQRL_ALLOCATOR_QUARANTINE_NUM; i++) {
+          allocator.deallocate(allocator.allocate(600), 600);
+        }
+#endif
+      },
+      "use after free");
+}
+
+TEST_F(MemoryHardenedTest, flush_quarantine) {
+  if (SQRL_ALLOCATOR_QUARANTINE_NUM == 0) {
+    GTEST_SKIP() << "built without quarantine";
+  }
+  word_t *data = allocator.allocate(600);
+  allocator.deallocate(data, 600);
+  // held back but released from user's point of view
+  EXPECT_TRUE(used(get_block(data)));
+  EXPECT_EQ(viewer.memory_used_size(), 0);
+  EXPECT_DEATH(
+      {
+        ((char *)data)[300] = 0;
+        manager.flush_quarantine();
+      },
+      "use after free");
+  manager.flush_quarantine();
+  EXPECT_EQ(viewer.memory_used_size(), 0);
+}
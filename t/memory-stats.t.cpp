@@ -0,0 +1,236 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <memory/_allocator_impl.h>
+#include <memory/allocator.h>
+#include <memory/profiler.h>
+#include <string>
+#include <thread>
+
+using namespace sqrl;
+
+static GenericAllocator allocator;
+static BlockViewer viewer;
+static BlockManager manager;
+
+class MemoryStatsTest : public ::testing::Test {
+protected:
+  void SetUp() { ASSERT_EQ(viewer.memory_used_size(), 0); }
+  void TearDown() {
+    manager.clear();
+    ASSERT_EQ(viewer.memory_used_size(), 0);
+    ASSERT_TRUE(viewer.safe_check());
+  }
+};
+
+static size_t count_blocks() {
+  size_t number = 0;
+  for (auto itr = viewer.get_head(); !itr.null(); itr.next()) {
+    number++;
+  }
+  return number;
+}
+
+TEST_F(MemoryStatsTest, alloc_and_free_count_by_size_class) {
+  size_t small = size_class(alloc_size(64));
+  size_t large = size_class(alloc_size(4096));
+  AllocatorStats before = viewer.stats();
+  word_t *data[4];
+  for (int i = 0; i < 4; i++) {
+    data[i] = allocator.allocate(64);
+  }
+  word_t *big = allocator.allocate(4096);
+  AllocatorStats stats = viewer.stats();
+  EXPECT_EQ(stats.alloc_count[small] - before.alloc_count[small], 4);
+  EXPECT_EQ(stats.alloc_count[large] - before.alloc_count[large], 1);
+  for (int i = 0; i < 4; i++) {
+    allocator.deallocate(data[i], 64);
+  }
+  allocator.deallocate(big, 4096);
+  manager.flush_quarantine();
+  stats = viewer.stats();
+  EXPECT_EQ(stats.free_count[small] - before.free_count[small], 4);
+  EXPECT_EQ(stats.free_count[large] - before.free_count[large], 1);
+  EXPECT_LE(size_class_min(small), alloc_size(64));
+  EXPECT_GT(size_class_min(small + 1), alloc_size(64));
+}
+
+TEST_F(MemoryStatsTest, block_number_counts_every_block) {
+  word_t *data[8];
+  for (int i = 0; i < 8; i++) {
+    data[i] = allocator.allocate(1024);
+  }
+  EXPECT_EQ(viewer.block_number(), count_blocks());
+  allocator.deallocate(data[3], 1024);
+  allocator.deallocate(data[4], 1024);
+  EXPECT_EQ(viewer.block_number(), count_blocks());
+  for (int i = 0; i < 8; i++) {
+    if (i != 3 && i != 4) {
+      allocator.deallocate(data[i], 1024);
+    }
+  }
+  EXPECT_EQ(viewer.block_number(), count_blocks());
+}
+
+TEST_F(MemoryStatsTest, only_stats_drains_remote_frees) {
+  word_t *data = allocator.allocate(4096);
+  word_t *next = allocator.allocate(4096);
+  size_t used_size = viewer.memory_used_size();
+  size_t blocks = viewer.block_number();
+  std::atomic<int> step{0};
+  std::thread releaser([&]() {
+    // a thread cache takes the heap lock once it comes and goes
+    ThreadCache::local();
+    step = 1;
+    while (step != 2) {
+      std::this_thread::yield();
+    }
+    allocator.deallocate(data, 4096);
+    step = 3;
+  });
+  while (step != 1) {
+    std::this_thread::yield();
+  }
+  // heap is held, the release is left to the holder
+  manager.mutex().lock();
+  step = 2;
+  while (step != 3) {
+    std::this_thread::yield();
+  }
+  manager.mutex().unlock();
+  releaser.join();
+  EXPECT_EQ(viewer.memory_used_size(), used_size - alloc_size(4096));
+  EXPECT_EQ(viewer.block_number(), blocks);
+#ifndef SQRL_HARDENED
+  EXPECT_TRUE(used(get_block(data)));
+#endif
+  AllocatorStats stats = viewer.stats();
+  EXPECT_EQ(stats.used_size, used_size - alloc_size(4096));
+#ifndef SQRL_HARDENED
+  EXPECT_FALSE(used(get_block(data)));
+#endif
+  allocator.deallocate(next, 4096);
+}
+
+TEST_F(MemoryStatsTest, peak_used_size) {
+  word_t *first = allocator.allocate(2048);
+  word_t *second = allocator.allocate(2048);
+  size_t peak = viewer.stats().peak_used_size;
+  EXPECT_GE(peak, 2 * alloc_size(2048));
+  allocator.deallocate(first, 2048);
+  allocator.deallocate(second, 2048);
+  AllocatorStats stats = viewer.stats();
+  EXPECT_EQ(stats.peak_used_size, peak);
+  EXPECT_EQ(stats.used_size, 0);
+}
+
+TEST_F(MemoryStatsTest, mmapped_size_of_large_block) {
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 2;
+  size_t before = viewer.stats().mmapped_size;
+  word_t *data = allocator.allocate(size);
+  AllocatorStats stats = viewer.stats();
+  EXPECT_GE(stats.mmapped_size - before, size);
+  EXPECT_EQ(stats.requested_size, stats.heap_size + stats.mmapped_size);
+  allocator.deallocate(data, size);
+  // the mapping may be cached for reuse
+  manager.release_mmap_cache();
+  EXPECT_EQ(viewer.stats().mmapped_size, before);
+}
+
+TEST_F(MemoryStatsTest, huge_page_size_of_large_block) {
+  size_t size = SQRL_BLOCK_HUGE_PAGE_SIZE + 1;
+  set_huge_page(true);
+  word_t *data = allocator.allocate(size);
+  set_huge_page(false);
+  ASSERT_TRUE(data != nullptr);
+  AllocatorStats stats = viewer.stats();
+  EXPECT_EQ(stats.huge_page_size, 2 * SQRL_BLOCK_HUGE_PAGE_SIZE);
+  EXPECT_GE(stats.mmapped_size, stats.huge_page_size);
+  EXPECT_GE(viewer.memory_used_size(), 2 * SQRL_BLOCK_HUGE_PAGE_SIZE);
+  allocator.deallocate(data, size);
+  EXPECT_EQ(viewer.stats().huge_page_size, 0);
+}
+
+TEST_F(MemoryStatsTest, free_block_histogram_and_fragmentation) {
+  word_t *data[6];
+  for (int i = 0; i < 6; i++) {
+    data[i] = allocator.allocate(1024);
+  }
+  // every other block released, none of them merge
+  allocator.deallocate(data[0], 1024);
+  allocator.deallocate(data[2], 1024);
+  allocator.deallocate(data[4], 1024);
+  manager.flush_quarantine();
+  AllocatorStats stats = viewer.stats();
+  size_t index = size_class(alloc_size(1024));
+  EXPECT_GE(stats.free_block_count[index], 3);
+  EXPECT_GE(stats.free_size, 3 * alloc_size(1024));
+  EXPECT_GT(stats.fragmentation, 0.0);
+  EXPECT_LT(stats.fragmentation, 1.0);
+  for (int i = 1; i < 6; i += 2) {
+    allocator.deallocate(data[i], 1024);
+  }
+  manager.flush_quarantine();
+  // all merged into one block
+  stats = viewer.stats();
+  EXPECT_EQ(stats.fragmentation, 0.0);
+}
+
+TEST_F(MemoryStatsTest, dump) {
+  word_t *data = allocator.allocate(64);
+  AllocatorStats stats = viewer.stats();
+  std::string text = stats.dump();
+  EXPECT_NE(text.find("used_size"), std::string::npos);
+  EXPECT_NE(text.find("fragmentation"), std::string::npos);
+  std::string json = stats.dump(DumpFormat::json);
+  EXPECT_EQ(json.front(), '{');
+  EXPECT_EQ(json.back(), '}');
+  EXPECT_NE(json.find("\"mmapped_size\": "), std::string::npos);
+  allocator.deallocate(data, 64);
+}
+
+TEST_F(MemoryStatsTest, profiler_samples_allocation_sites) {
+  HeapProfiler::start(1);
+  word_t *data[4];
+  for (int i = 0; i < 4; i++) {
+    data[i] = allocator.allocate(100);
+  }
+  HeapProfiler::stop();
+  std::string json = HeapProfiler::dump(DumpFormat::json);
+  EXPECT_NE(json.find("\"samples\": 4"), std::string::npos);
+  EXPECT_NE(json.find("\"live_bytes\": 400"), std::string::npos);
+  HeapProfiler::start(1);
+  word_t *other = allocator.allocate(100);
+  allocator.deallocate(other, 100);
+  HeapProfiler::stop();
+  json = HeapProfiler::dump(DumpFormat::json);
+  EXPECT_NE(json.find("\"samples\": 1"), std::string::npos);
+  EXPECT_NE(json.find("\"live_bytes\": 0"), std::string::npos);
+  std::string text = HeapProfiler::dump();
+  EXPECT_NE(text.find("heap profile"), std::string::npos);
+  // not sampled once stopped
+  HeapProfiler::reset();
+  for (int i = 0; i < 4; i++) {
+    allocator.deallocate(data[i], 100);
+  }
+  EXPECT_EQ(HeapProfiler::dump(DumpFormat::json).find("\"samples\""),
+            std::string::npos);
+}
+
+TEST_F(MemoryStatsTest, profiler_tracks_releases_till_reset) {
+  HeapProfiler::start(1);
+  word_t *data = allocator.allocate(100);
+  // churn more samples than the live table holds, removed ones leave no
+  // slot behind
+  for (size_t i = 0; i < SQRL_PROFILER_LIVE_NUM; i++) {
+    allocator.deallocate(allocator.allocate(100), 100);
+  }
+  HeapProfiler::stop();
+  std::string json = HeapProfiler::dump(DumpFormat::json);
+  EXPECT_NE(json.find("\"dropped\": 0"), std::string::npos);
+  // released after stop, it is no longer live
+  allocator.deallocate(data, 100);
+  json = HeapProfiler::dump(DumpFormat::json);
+  EXPECT_EQ(json.find("\"live_bytes\": 100"), std::string::npos);
+  EXPECT_NE(json.find("\"live_bytes\": 0"), std::string::npos);
+  HeapProfiler::reset();
+}
@@ -0,0 +1,135 @@
+#include <container/mpmc_queue.h>
+#include <gtest/gtest.h>
+#include <memory/_allocator_impl.h>
+#include <thread>
+#include <vector>
+
+using namespace sqrl;
+
+static BlockViewer viewer;
+
+static int reference_count = 0;
+class C {
+public:
+  C(int x = 0) : data(x) { reference_count++; }
+  C(const C &other) : data(other.data) { reference_count++; }
+  C &operator=(const C &other) = default;
+  ~C() { reference_count--; }
+  int data;
+};
+
+TEST(mpmc_queue_test, first_in_first_out) {
+  MPMCQueue<int> q(50);
+  EXPECT_EQ(q.capacity(), 64);
+  // go around the ring a few times
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < 40; i++) {
+      ASSERT_TRUE(q.try_push(i));
+    }
+    EXPECT_EQ(q.size(), 40);
+    int out;
+    for (int i = 0; i < 40; i++) {
+      ASSERT_TRUE(q.try_pop(out));
+      ASSERT_EQ(out, i);
+    }
+  }
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(mpmc_queue_test, try_fails_when_full_or_empty) {
+  MPMCQueue<int> q(4);
+  int out;
+  EXPECT_FALSE(q.try_pop(out));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(q.try_push(i));
+  }
+  EXPECT_FALSE(q.try_push(4));
+  EXPECT_TRUE(q.try_pop(out));
+  EXPECT_EQ(out, 0);
+  EXPECT_TRUE(q.try_push(4));
+}
+
+TEST(mpmc_queue_test, tiny_capacity) {
+  for (size_t size : {0, 1}) {
+    MPMCQueue<int> q(size);
+    int out;
+    EXPECT_EQ(q.capacity(), 2);
+    EXPECT_TRUE(q.try_push(1));
+    EXPECT_TRUE(q.try_push(2));
+    EXPECT_FALSE(q.try_push(3));
+    EXPECT_EQ(q.size(), 2);
+    for (int round = 0; round < 3; round++) {
+      EXPECT_TRUE(q.try_pop(out));
+      EXPECT_EQ(out, round + 1);
+      EXPECT_TRUE(q.try_push(round + 3));
+      EXPECT_FALSE(q.try_push(0));
+    }
+    EXPECT_TRUE(q.try_pop(out));
+    EXPECT_EQ(out, 4);
+    EXPECT_TRUE(q.try_pop(out));
+    EXPECT_EQ(out, 5);
+    EXPECT_FALSE(q.try_pop(out));
+  }
+}
+
+TEST(mpmc_queue_test, destroy_elements_left) {
+  {
+    MPMCQueue<C> q(8);
+    for (int i = 0; i < 6; i++) {
+      q.emplace(i);
+    }
+    C out;
+    q.pop(out);
+    EXPECT_EQ(out.data, 0);
+    EXPECT_EQ(reference_count, 6);
+  }
+  EXPECT_EQ(reference_count, 0);
+  EXPECT_EQ(viewer.memory_size(), 0);
+}
+
+// every element pushed is popped exactly once
+TEST(mpmc_queue_test, many_producers_many_consumers) {
+  const int threads = 4;
+  const int items = 20000;
+  MPMCQueue<int> q(16);
+  std::vector<std::atomic<int>> seen(threads * items);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&q, t]() {
+      for (int i = 0; i < items; i++) {
+        q.push(t * items + i);
+      }
+    });
+    workers.emplace_back([&q, &seen]() {
+      int out;
+      for (int i = 0; i < items; i++) {
+        q.pop(out);
+        seen[out]++;
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  for (int i = 0; i < threads * items; i++) {
+    ASSERT_EQ(seen[i], 1);
+  }
+  EXPECT_TRUE(q.empty());
+}
+
+// one producer, elements come out in order of push
+TEST(mpmc_queue_test, order_of_a_producer) {
+  const int items = 50000;
+  MPMCQueue<int> q(8);
+  std::thread producer([&q]() {
+    for (int i = 0; i < items; i++) {
+      q.push(i);
+    }
+  });
+  int out;
+  for (int i = 0; i < items; i++) {
+    q.pop(out);
+    ASSERT_EQ(out, i);
+  }
+  producer.join();
+}
@@ -0,0 +1,142 @@
+#include <container/mpsc_queue.h>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace sqrl;
+
+struct Item : MPSCNode {
+  Item(int value = 0) : value(value) {}
+  int value;
+};
+
+static int reference_count = 0;
+class C {
+public:
+  C(int x = 0) : data(x) { reference_count++; }
+  C(const C &other) : data(other.data) { reference_count++; }
+  C &operator=(const C &other) = default;
+  ~C() { reference_count--; }
+  int data;
+};
+
+TEST(mpsc_queue_test, first_in_first_out) {
+  MPSCQueue<Item> q;
+  EXPECT_TRUE(q.empty());
+  EXPECT_EQ(q.pop(), nullptr);
+  Item items[10];
+  // stub goes around a few times
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 10; i++) {
+      items[i].value = round * 10 + i;
+      q.push(&items[i]);
+    }
+    EXPECT_FALSE(q.empty());
+    for (int i = 0; i < 10; i++) {
+      Item *item = q.pop();
+      ASSERT_EQ(item, &items[i]);
+      ASSERT_EQ(item->value, round * 10 + i);
+    }
+    EXPECT_EQ(q.pop(), nullptr);
+    EXPECT_TRUE(q.empty());
+  }
+}
+
+TEST(mpsc_queue_test, pop_n) {
+  MPSCQueue<Item> q;
+  Item items[5];
+  for (auto &item : items) {
+    q.push(&item);
+  }
+  Item *out[8];
+  EXPECT_EQ(q.pop_n(out, 3), 3);
+  EXPECT_EQ(out[2], &items[2]);
+  EXPECT_EQ(q.pop_n(out, 8), 2);
+  EXPECT_EQ(out[1], &items[4]);
+}
+
+// every element is taken once, in order of its producer
+TEST(mpsc_queue_test, many_producers) {
+  const int threads = 4;
+  const int items = 20000;
+  MPSCQueue<Item> q;
+  std::vector<Item> nodes(threads * items);
+  std::vector<std::thread> producers;
+  for (int t = 0; t < threads; t++) {
+    producers.emplace_back([&q, &nodes, t]() {
+      for (int i = 0; i < items; i++) {
+        Item &item = nodes[t * items + i];
+        item.value = t * items + i;
+        q.push(&item);
+      }
+    });
+  }
+  int last[threads] = {-1, -1, -1, -1};
+  int taken = 0;
+  while (taken < threads * items) {
+    Item *item = q.pop();
+    if (item == nullptr) {
+      std::this_thread::yield();
+      continue;
+    }
+    int t = item->value / items;
+    ASSERT_GT(item->value, last[t]);
+    last[t] = item->value;
+    taken++;
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  EXPECT_EQ(q.pop(), nullptr);
+}
+
+TEST(mpsc_queue_test, inbox_drain) {
+  {
+    Inbox<C> inbox;
+    for (int i = 0; i < 10; i++) {
+      inbox.emplace(i);
+    }
+    EXPECT_EQ(reference_count, 10);
+    C out[4];
+    EXPECT_EQ(inbox.drain(out, 4), 4);
+    EXPECT_EQ(out[3].data, 3);
+    EXPECT_EQ(reference_count, 10);
+    C one;
+    EXPECT_TRUE(inbox.try_pop(one));
+    EXPECT_EQ(one.data, 4);
+  }
+  // values left are destroyed with the inbox
+  EXPECT_EQ(reference_count, 0);
+}
+
+TEST(mpsc_queue_test, inbox_many_submitters) {
+  const int threads = 4;
+  const int items = 10000;
+  Inbox<int> inbox;
+  std::vector<std::thread> submitters;
+  for (int t = 0; t < threads; t++) {
+    submitters.emplace_back([&inbox]() {
+      for (int i = 0; i < items; i++) {
+        inbox.push(i);
+      }
+    });
+  }
+  long long sum = 0;
+  int taken = 0;
+  int out[64];
+  while (taken < threads * items) {
+    size_t n = inbox.drain(out, 64);
+    if (n == 0) {
+      std::this_thread::yield();
+    }
+    for (size_t i = 0; i < n; i++) {
+      sum += out[i];
+    }
+    taken += n;
+  }
+  for (auto &submitter : submitters) {
+    submitter.join();
+  }
+  EXPECT_EQ(sum, (long long)threads * items * (items - 1) / 2);
+  EXPECT_TRUE(inbox.empty());
+}
@@ -0,0 +1,111 @@
+#include <container/vector.h>
+#include <gtest/gtest.h>
+#include <memory/_allocator_impl.h>
+#include <memory/pool.h>
+#include <thread>
+
+using namespace sqrl;
+
+static BlockViewer viewer;
+
+struct Node {
+  Node *next;
+  int64_t value;
+};
+
+struct alignas(32) Wide {
+  char data[40];
+};
+
+TEST(pool_test, allocate_distinct_objects) {
+  PoolAllocator<Node, 8> pool;
+  Node *nodes[100];
+  for (int i = 0; i < 100; i++) {
+    nodes[i] = pool.allocate(1);
+    nodes[i]->value = i;
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(nodes[i]->value, i);
+  }
+  for (int i = 0; i < 100; i++) {
+    pool.deallocate(nodes[i], 1);
+  }
+}
+
+TEST(pool_test, reuse_released_slot) {
+  PoolAllocator<Node> pool;
+  Node *first = pool.allocate(1);
+  Node *second = pool.allocate(1);
+  pool.deallocate(first, 1);
+  EXPECT_EQ(pool.allocate(1), first);
+  pool.deallocate(second, 1);
+  EXPECT_EQ(pool.allocate(1), second);
+}
+
+TEST(pool_test, slab_is_cache_line_aligned) {
+  PoolAllocator<Wide, 4> pool;
+  for (int i = 0; i < 12; i++) {
+    Wide *wide = pool.allocate(1);
+    EXPECT_EQ((uintptr_t)wide % alignof(Wide), 0);
+    if (i % 4 == 0) {
+      EXPECT_EQ((uintptr_t)wide % SQRL_POOL_CACHE_LINE, 0);
+    }
+  }
+}
+
+TEST(pool_test, many_aligned_objects_from_upstream) {
+  PoolAllocator<Wide> pool;
+  for (size_t size = 2; size < 10; size++) {
+    Wide *wide = pool.allocate(size);
+    EXPECT_EQ((uintptr_t)wide % alignof(Wide), 0);
+    pool.deallocate(wide, size);
+  }
+}
+
+TEST(pool_test, many_objects_from_upstream) {
+  Vector<int, PoolAllocator<int>> v;
+  for (int i = 0; i < 1000; i++) {
+    v.push_back(i);
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(v[i], i);
+  }
+}
+
+TEST(pool_test, copies_share_pool) {
+  PoolAllocator<Node> pool;
+  Node *node = pool.allocate(1);
+  PoolAllocator<Node> copy(pool);
+  EXPECT_TRUE(copy == pool);
+  copy.deallocate(node, 1);
+  EXPECT_EQ(pool.allocate(1), node);
+  // a pool of another type is a new one
+  PoolAllocator<int> other(pool);
+  PoolAllocator<int> other_copy(other);
+  EXPECT_TRUE(other == other_copy);
+}
+
+TEST(pool_test, copies_made_on_threads_share_pool) {
+  for (int i = 0; i < 100; i++) {
+    PoolAllocator<Node> pool;
+    PoolAllocator<Node> *copies[2];
+    std::thread first([&]() { copies[0] = new PoolAllocator<Node>(pool); });
+    std::thread second([&]() { copies[1] = new PoolAllocator<Node>(pool); });
+    first.join();
+    second.join();
+    EXPECT_TRUE(*copies[0] == pool);
+    EXPECT_TRUE(*copies[1] == pool);
+    delete copies[0];
+    delete copies[1];
+  }
+}
+
+TEST(pool_test, compare_without_allocation) {
+  size_t used = viewer.memory_used_size();
+  PoolAllocator<Node> pool;
+  PoolAllocator<Node> other;
+  // neither has a pool yet, nothing is created to compare them
+  EXPECT_TRUE(pool == pool);
+  EXPECT_FALSE(pool == other);
+  EXPECT_EQ(viewer.memory_used_size(), used);
+}
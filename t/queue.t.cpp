@@ -110,4 +110,169 @@ TEST(test_queue, call_destructor_and_free_memory) {
   }
   ASSERT_EQ(viewer.memory_size(), 0);
   ASSERT_EQ(reference_count, 0);
-}
\ No newline at end of file
+}
+// owns its data, a moved one is left empty
+class D {
+public:
+  D(int x) : data(new int(x)) { reference_count++; }
+  D(D &&other) noexcept : data(other.data) {
+    other.data = nullptr;
+    reference_count++;
+  }
+  D &operator=(D &&other) noexcept {
+    delete data;
+    data = other.data;
+    other.data = nullptr;
+    return *this;
+  }
+  ~D() {
+    reference_count--;
+    delete data;
+  }
+  int *data;
+};
+
+TEST(test_queue, capacity_is_power_of_two) {
+  Queue<int> q(50);
+  EXPECT_EQ(q.capacity(), 64);
+  Queue<int> one(1);
+  EXPECT_EQ(one.capacity(), 1);
+}
+
+TEST(test_queue, grow_when_full) {
+  {
+    Queue<D> q(4);
+    // make queue wrap around before it grows
+    for (int i = 0; i < 3; i++) {
+      q.emplace(-1);
+    }
+    for (int i = 0; i < 3; i++) {
+      q.pop();
+    }
+    for (int i = 0; i < 1000; i++) {
+      q.emplace(i);
+    }
+    EXPECT_EQ(q.size(), 1000);
+    EXPECT_EQ(q.capacity(), 1024);
+    EXPECT_EQ(reference_count, 1000);
+    for (int i = 0; i < 500; i++) {
+      ASSERT_EQ(*q.front().data, i);
+      q.pop();
+    }
+    // popped elements are destroyed
+    EXPECT_EQ(reference_count, 500);
+  }
+  ASSERT_EQ(reference_count, 0);
+  ASSERT_EQ(viewer.memory_size(), 0);
+}
+
+TEST(test_queue, push_front_of_full_queue) {
+  Queue<int> q(2);
+  q.push(1);
+  q.push(2);
+  q.push(q.front());
+  EXPECT_EQ(q.size(), 3);
+  q.pop();
+  q.pop();
+  EXPECT_EQ(q.front(), 1);
+}
+
+TEST(test_queue, push_n_and_pop_n) {
+  Queue<int> q(8);
+  int items[100];
+  for (int i = 0; i < 100; i++) {
+    items[i] = i;
+  }
+  int out[100];
+  q.push_n(items, 6);
+  EXPECT_EQ(q.pop_n(out, 4), 4);
+  EXPECT_EQ(out[3], 3);
+  // wraps around the end of space
+  q.push_n(items + 6, 5);
+  EXPECT_EQ(q.capacity(), 8);
+  EXPECT_EQ(q.size(), 7);
+  q.push_n(items + 11, 89);
+  EXPECT_EQ(q.capacity(), 128);
+  EXPECT_EQ(q.pop_n(out, 200), 96);
+  for (int i = 0; i < 96; i++) {
+    ASSERT_EQ(out[i], i + 4);
+  }
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(test_queue, pop_n_moves_objects) {
+  {
+    Queue<D> q(4);
+    for (int i = 0; i < 3; i++) {
+      q.emplace(i);
+    }
+    D out[2] = {D(-1), D(-1)};
+    int *data = q.front().data;
+    EXPECT_EQ(q.pop_n(out, 2), 2);
+    EXPECT_EQ(out[0].data, data);
+    EXPECT_EQ(*out[1].data, 1);
+    EXPECT_EQ(q.size(), 1);
+    EXPECT_EQ(reference_count, 3);
+  }
+  ASSERT_EQ(reference_count, 0);
+}
+
+TEST(test_queue, move_allocates_nothing) {
+  Queue<D> q(4);
+  q.emplace(1);
+  q.emplace(2);
+  D *front = &q.front();
+  size_t used = viewer.memory_used_size();
+  Queue<D> moved(std::move(q));
+  EXPECT_EQ(&moved.front(), front);
+  EXPECT_EQ(moved.size(), 2);
+  // the moved one has no space left
+  EXPECT_EQ(q.capacity(), 0);
+  EXPECT_TRUE(q.empty());
+  EXPECT_EQ(viewer.memory_used_size(), used);
+  Queue<D> assigned(2);
+  assigned = std::move(moved);
+  EXPECT_EQ(moved.capacity(), 0);
+  EXPECT_EQ(*assigned.front().data, 1);
+  // a moved one allocates again once an element comes
+  q.emplace(3);
+  EXPECT_EQ(*q.front().data, 3);
+  EXPECT_EQ(q.capacity(), SQRL_QUEUE_DEFAULT_INIT_SIZE);
+}
+
+// allocator sharing a counter between copies, it never propagates on move
+template <typename T> struct CountingAllocator {
+  using value_type = T;
+  int *count;
+  sqrl::Allocator<T> impl;
+  CountingAllocator(int *count) : count(count) {}
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U> &other) : count(other.count) {}
+  T *allocate(size_t size) {
+    (*count)++;
+    return impl.allocate(size);
+  }
+  void deallocate(T *t, size_t size) {
+    (*count)--;
+    impl.deallocate(t, size);
+  }
+};
+
+TEST(test_queue, move_assign_moved_queue_allocates_nothing) {
+  int count = 0;
+  {
+    CountingAllocator<int> alloc(&count);
+    Queue<int, CountingAllocator<int>> q(4, alloc);
+    Queue<int, CountingAllocator<int>> moved(std::move(q));
+    Queue<int, CountingAllocator<int>> assigned(4, alloc);
+    EXPECT_EQ(count, 2);
+    // elements are moved one by one, none of them is there
+    assigned = std::move(q);
+    EXPECT_EQ(count, 1);
+    EXPECT_EQ(assigned.capacity(), 0);
+    assigned.push(1);
+    EXPECT_EQ(assigned.front(), 1);
+    EXPECT_EQ(count, 2);
+  }
+  EXPECT_EQ(count, 0);
+}
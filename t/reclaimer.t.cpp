@@ -0,0 +1,128 @@
+#include <chrono>
+#include <gtest/gtest.h>
+#include <memory/allocator.h>
+#include <memory/reclaimer.h>
+#include <unistd.h>
+
+using namespace sqrl;
+
+static Allocator<char> allocator;
+static BlockViewer viewer;
+static BlockManager manager;
+
+class ReclaimerTest : public ::testing::Test {
+protected:
+  void SetUp() { ASSERT_EQ(viewer.memory_size(), 0); }
+  void TearDown() {
+    manager.clear();
+    ASSERT_EQ(viewer.memory_size(), 0);
+    ASSERT_TRUE(viewer.safe_check());
+  }
+};
+
+TEST_F(ReclaimerTest, trim_released_top) {
+  Reclaimer reclaimer;
+  size_t size = 100000;
+  char *data = allocator.allocate(size);
+  size_t requested = viewer.memory_requested_size();
+  allocator.deallocate(data, size);
+  manager.flush_quarantine();
+  reclaimer.run();
+  // the released top is given back except the pad
+  EXPECT_GT(reclaimer.trimmed_size(), 0);
+  EXPECT_EQ(viewer.memory_requested_size(),
+            requested - reclaimer.trimmed_size());
+  EXPECT_FALSE(viewer.get_top().is_used());
+  EXPECT_LT(viewer.get_top().size(),
+            SQRL_RECLAIMER_TOP_PAD + sysconf(_SC_PAGESIZE));
+  EXPECT_EQ((char *)heap_end(), (char *)viewer.get_top().get_data() -
+                                 sizeof(BlockHeader) +
+                                 viewer.get_top().size());
+}
+
+TEST_F(ReclaimerTest, purge_large_released_block) {
+  Reclaimer reclaimer;
+  size_t size = 100000;
+  char *front = allocator.allocate(1000);
+  char *data = allocator.allocate(size);
+  char *back = allocator.allocate(1000);
+  for (size_t i = 0; i < 1000; i++) {
+    front[i] = 'f';
+    back[i] = 'b';
+  }
+  for (size_t i = 0; i < size; i++) {
+    data[i] = 'd';
+  }
+  allocator.deallocate(data, size);
+  manager.flush_quarantine();
+  reclaimer.run();
+  EXPECT_GE(reclaimer.purged_size(), size - 3 * sysconf(_SC_PAGESIZE));
+  // neighbours are not touched
+  for (size_t i = 0; i < 1000; i++) {
+    ASSERT_EQ(front[i], 'f');
+    ASSERT_EQ(back[i], 'b');
+  }
+  // purged block is still usable
+  data = allocator.allocate(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = 'd';
+  }
+  allocator.deallocate(data, size);
+  allocator.deallocate(front, 1000);
+  allocator.deallocate(back, 1000);
+}
+
+TEST_F(ReclaimerTest, keep_recently_cached_mapping) {
+#ifdef SQRL_HARDENED
+  GTEST_SKIP() << "guarded large blocks are never cached";
+#endif
+  Reclaimer reclaimer;
+  size_t size = SQRL_ALLOCATOR_MMAP_THRESHOLD * 4;
+  manager.set_mmap_threshold(SQRL_ALLOCATOR_MMAP_THRESHOLD);
+  char *data = allocator.allocate(size);
+  allocator.deallocate(data, size);
+  EXPECT_EQ(viewer.stats().mmap_cache_size, alloc_size(size));
+  // still there for the next large allocation after a pass
+  reclaimer.run();
+  EXPECT_EQ(viewer.stats().mmap_cache_size, alloc_size(size));
+  data = allocator.allocate(size);
+  allocator.deallocate(data, size);
+  reclaimer.run();
+  EXPECT_EQ(viewer.stats().mmap_cache_size, alloc_size(size));
+  // idle for a whole pass
+  size_t trimmed = reclaimer.trimmed_size();
+  reclaimer.run();
+  EXPECT_EQ(viewer.stats().mmap_cache_size, 0);
+  EXPECT_GE(reclaimer.trimmed_size(), trimmed + alloc_size(size));
+}
+
+TEST_F(ReclaimerTest, incremental_step) {
+  char *blocks[10];
+  for (size_t i = 0; i < 10; i++) {
+    blocks[i] = allocator.allocate(1000);
+  }
+  // only visit one block each step
+  Reclaimer reclaimer(1);
+  size_t steps = 1;
+  while (!reclaimer.step()) {
+    steps++;
+  }
+  EXPECT_GE(steps, 10);
+  for (size_t i = 0; i < 10; i++) {
+    allocator.deallocate(blocks[i], 1000);
+  }
+}
+
+TEST_F(ReclaimerTest, run_on_background_thread) {
+  Reclaimer reclaimer;
+  reclaimer.start(std::chrono::milliseconds(1));
+  for (size_t i = 0; i < 10000; i++) {
+    size_t size = 1000 + i % 100000;
+    char *data = allocator.allocate(size);
+    data[0] = 'x';
+    data[size - 1] = 'x';
+    allocator.deallocate(data, size);
+  }
+  reclaimer.stop();
+  ASSERT_TRUE(viewer.safe_check());
+}
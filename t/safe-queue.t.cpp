@@ -1,3 +1,5 @@
+#include <atomic>
+#include <chrono>
 #include <container/safe_queue.h>
 #include <gtest/gtest.h>
 #include <thread>
@@ -7,7 +9,6 @@ using namespace sqrl;
 static const int MAX_LOOP_NUM = 10; // TODO: raise the loop number to 100
 
 class SafeQueueTest : public ::testing::TestWithParam<int> {};
-class BlockFreeQueueTest : public ::testing::TestWithParam<int> {};
 
 template <template <class> class Q, typename D = int>
 void test_producer_simple() {
@@ -72,9 +73,11 @@ void test_queue_read_write() {
       }
     }
   };
+  // consumers wait for producers
   auto consumer = [&sq](size_t batch_size) {
+    D out;
     for (size_t i = 0; i < batch_size; i++) {
-      sq.pop();
+      sq.wait_and_pop(out);
     }
   };
   std::thread t1(producer, 200);
@@ -96,19 +99,86 @@ TEST_P(SafeQueueTest, simple_consumer) { test_consumer_simple<SafeQueue>(); }
 
 TEST_P(SafeQueueTest, read_write) { test_queue_read_write<SafeQueue>(); }
 
-TEST_P(BlockFreeQueueTest, simple_producer) {
-  test_producer_simple<BlockFreeQueue>();
+INSTANTIATE_TEST_SUITE_P(test_safe_queue, SafeQueueTest,
+                         ::testing::Range(1, MAX_LOOP_NUM));
+
+TEST(safe_queue_test, pop_in_order) {
+  SafeQueue<int> sq(4);
+  for (int i = 0; i < 10; i++) {
+    sq.push(i);
+  }
+  int out;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(sq.try_pop(out));
+    ASSERT_EQ(out, i);
+  }
+  EXPECT_FALSE(sq.try_pop(out));
 }
 
-TEST_P(BlockFreeQueueTest, simple_consumer) {
-  test_consumer_simple<BlockFreeQueue>();
+TEST(safe_queue_test, wait_and_pop_parks_consumer) {
+  SafeQueue<int> sq;
+  int out = 0;
+  std::thread consumer([&sq, &out]() { ASSERT_TRUE(sq.wait_and_pop(out)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  sq.push(42);
+  consumer.join();
+  EXPECT_EQ(out, 42);
 }
 
-TEST_P(BlockFreeQueueTest, read_write) {
-  test_queue_read_write<BlockFreeQueue>();
+TEST(safe_queue_test, try_pop_for_times_out) {
+  SafeQueue<int> sq;
+  int out = 0;
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(sq.try_pop_for(out, std::chrono::milliseconds(20)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(20));
+  sq.push(1);
+  EXPECT_TRUE(sq.try_pop_for(out, std::chrono::milliseconds(20)));
+  EXPECT_EQ(out, 1);
 }
 
-INSTANTIATE_TEST_SUITE_P(test_safe_queue, SafeQueueTest,
-                         ::testing::Range(1, MAX_LOOP_NUM));
-INSTANTIATE_TEST_SUITE_P(test_block_free_queue, BlockFreeQueueTest,
-                         ::testing::Range(1, MAX_LOOP_NUM));
\ No newline at end of file
+TEST(safe_queue_test, close_wakes_up_consumers) {
+  SafeQueue<int> sq;
+  std::thread consumers[3];
+  std::atomic<int> woken{0};
+  for (auto &consumer : consumers) {
+    consumer = std::thread([&sq, &woken]() {
+      int out;
+      EXPECT_FALSE(sq.wait_and_pop(out));
+      woken++;
+    });
+  }
+  sq.close();
+  for (auto &consumer : consumers) {
+    consumer.join();
+  }
+  EXPECT_EQ(woken, 3);
+  EXPECT_TRUE(sq.closed());
+  EXPECT_FALSE(sq.push(1));
+  EXPECT_TRUE(sq.empty());
+}
+
+TEST(safe_queue_test, elements_left_after_close) {
+  SafeQueue<int> sq;
+  sq.push(1);
+  sq.close();
+  int out;
+  EXPECT_TRUE(sq.wait_and_pop(out));
+  EXPECT_EQ(out, 1);
+  EXPECT_FALSE(sq.wait_and_pop(out));
+}
+
+TEST(safe_queue_test, drain_by_batches) {
+  SafeQueue<int> sq;
+  int items[100];
+  for (int i = 0; i < 100; i++) {
+    items[i] = i;
+  }
+  EXPECT_TRUE(sq.push_n(items, 100));
+  int out[64];
+  EXPECT_EQ(sq.drain(out, 64), 64);
+  EXPECT_EQ(out[63], 63);
+  EXPECT_EQ(sq.drain(out, 64), 36);
+  EXPECT_EQ(out[0], 64);
+  EXPECT_EQ(sq.drain(out, 64), 0);
+}
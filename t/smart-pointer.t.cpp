@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <memory/pool.h>
 #include <memory/smart_pointer.h>
 
 using namespace sqrl;
@@ -240,4 +241,69 @@ TEST(shared_ptr_test, set_to_nullptr_will_not_cleanup_memory) {
   EXPECT_EQ(_test_allocator::get_free_size(), 0);
   EXPECT_EQ(*a, 100);
   delete a;
-}
\ No newline at end of file
+}
+static int alive_count = 0;
+struct Counted {
+  int x;
+  Counted(int x) : x(x) { alive_count++; }
+  ~Counted() { alive_count--; }
+};
+
+TEST(unique_ptr_test, alloc_unique) {
+  {
+    auto ptr = alloc_unique<Counted>(sqrl::Allocator<char>(), 3);
+    EXPECT_EQ(ptr->x, 3);
+    EXPECT_EQ(alive_count, 1);
+    auto moved = std::move(ptr);
+    EXPECT_TRUE(ptr.is_null());
+    EXPECT_EQ(moved->x, 3);
+  }
+  EXPECT_EQ(alive_count, 0);
+}
+
+TEST(shared_ptr_test, alloc_shared) {
+  {
+    auto ptr = alloc_shared<Counted>(sqrl::Allocator<char>(), 4);
+    {
+      auto copy = ptr;
+      EXPECT_EQ(copy.get_count(), 2);
+    }
+    EXPECT_EQ(ptr->x, 4);
+    EXPECT_EQ(alive_count, 1);
+  }
+  EXPECT_EQ(alive_count, 0);
+}
+
+struct Big : Counted {
+  Big(int x) : Counted(x) {}
+  char payload[200];
+};
+
+TEST(unique_ptr_test, alloc_unique_pool) {
+  {
+    // the pool rebound to Big outlives the temporary allocator
+    auto ptr = alloc_unique<Big>(PoolAllocator<char>(), 7);
+    auto other = alloc_unique<Big>(PoolAllocator<char>(), 8);
+    EXPECT_EQ(ptr->x, 7);
+    EXPECT_EQ(other->x, 8);
+    EXPECT_EQ(alive_count, 2);
+    auto moved = std::move(ptr);
+    EXPECT_EQ(moved->x, 7);
+  }
+  EXPECT_EQ(alive_count, 0);
+}
+
+TEST(shared_ptr_test, alloc_shared_pool) {
+  {
+    PoolAllocator<char> pool;
+    auto ptr = alloc_shared<Big>(pool, 9);
+    {
+      auto copy = ptr;
+      EXPECT_EQ(copy->x, 9);
+      EXPECT_EQ(copy.get_count(), 2);
+    }
+    EXPECT_EQ(ptr->x, 9);
+    EXPECT_EQ(alive_count, 1);
+  }
+  EXPECT_EQ(alive_count, 0);
+}
@@ -0,0 +1,120 @@
+#include <container/spsc_queue.h>
+#include <gtest/gtest.h>
+#include <memory/_allocator_impl.h>
+#include <thread>
+
+using namespace sqrl;
+
+static BlockViewer viewer;
+
+static int reference_count = 0;
+class C {
+public:
+  C(int x = 0) : data(x) { reference_count++; }
+  C(const C &other) : data(other.data) { reference_count++; }
+  C &operator=(const C &other) = default;
+  ~C() { reference_count--; }
+  int data;
+};
+
+TEST(spsc_queue_test, first_in_first_out) {
+  SPSCQueue<int> q(50);
+  EXPECT_EQ(q.capacity(), 64);
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < 40; i++) {
+      ASSERT_TRUE(q.try_push(i));
+    }
+    EXPECT_EQ(q.size(), 40);
+    int out;
+    for (int i = 0; i < 40; i++) {
+      ASSERT_TRUE(q.try_pop(out));
+      ASSERT_EQ(out, i);
+    }
+  }
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(spsc_queue_test, try_fails_when_full_or_empty) {
+  SPSCQueue<int> q(4);
+  int out;
+  EXPECT_FALSE(q.try_pop(out));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(q.try_push(i));
+  }
+  EXPECT_FALSE(q.try_push(4));
+  EXPECT_TRUE(q.try_pop(out));
+  EXPECT_EQ(out, 0);
+  EXPECT_TRUE(q.try_push(4));
+}
+
+TEST(spsc_queue_test, push_n_and_pop_n) {
+  SPSCQueue<int> q(8);
+  int items[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  int out[10];
+  EXPECT_EQ(q.push_n(items, 6), 6);
+  EXPECT_EQ(q.pop_n(out, 4), 4);
+  // wraps around the end of space, only room of 6 is left
+  EXPECT_EQ(q.push_n(items + 6, 4), 4);
+  EXPECT_EQ(q.push_n(items, 10), 2);
+  EXPECT_EQ(q.pop_n(out, 10), 8);
+  int expected[] = {4, 5, 6, 7, 8, 9, 0, 1};
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(out[i], expected[i]);
+  }
+  EXPECT_EQ(q.pop_n(out, 10), 0);
+}
+
+TEST(spsc_queue_test, destroy_elements_left) {
+  {
+    SPSCQueue<C> q(8);
+    C items[3] = {C(1), C(2), C(3)};
+    q.push_n(items, 3);
+    q.emplace(4);
+    C out;
+    q.pop(out);
+    EXPECT_EQ(out.data, 1);
+    EXPECT_EQ(reference_count, 7);
+  }
+  EXPECT_EQ(reference_count, 0);
+  EXPECT_EQ(viewer.memory_size(), 0);
+}
+
+// elements come out in order, single ones and batches alike
+TEST(spsc_queue_test, producer_and_consumer_threads) {
+  const int items = 100000;
+  SPSCQueue<int> q(64);
+  std::thread producer([&q]() {
+    int batch[16];
+    int i = 0;
+    size_t spins = 0;
+    while (i < items) {
+      if (i % 3 == 0) {
+        q.push(i++);
+        continue;
+      }
+      int n = items - i < 16 ? items - i : 16;
+      for (int j = 0; j < n; j++) {
+        batch[j] = i + j;
+      }
+      size_t pushed = q.push_n(batch, n);
+      if (pushed == 0) {
+        _queue_backoff(spins);
+      }
+      i += pushed;
+    }
+  });
+  int out[16];
+  int i = 0;
+  size_t spins = 0;
+  while (i < items) {
+    size_t popped = q.pop_n(out, 16);
+    if (popped == 0) {
+      _queue_backoff(spins);
+    }
+    for (size_t j = 0; j < popped; j++) {
+      ASSERT_EQ(out[j], i++);
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(q.empty());
+}
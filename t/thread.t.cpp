@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <thread/thread.h>
 
 void add(int *x, int *y, int *sum) { (*sum) = (*x) + (*y); }
@@ -55,4 +56,35 @@ TEST(thread_wrapper, jthread_raii) {
   EXPECT_EQ(x, 30);
   EXPECT_EQ(y, 40);
   EXPECT_EQ(sum, 70);
-}
\ No newline at end of file
+}
+
+// allocator counting live allocations, copies share the counter
+template <typename T> struct CountingAllocator {
+  using value_type = T;
+  std::atomic<int> *count;
+  sqrl::Allocator<T> impl;
+  CountingAllocator(std::atomic<int> *count) : count(count) {}
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U> &other) : count(other.count) {}
+  T *allocate(size_t size) {
+    (*count)++;
+    return impl.allocate(size);
+  }
+  void deallocate(T *t, size_t size) {
+    (*count)--;
+    impl.deallocate(t, size);
+  }
+};
+
+TEST(thread_wrapper, thread_with_allocator) {
+  std::atomic<int> count = 0;
+  int x = 30;
+  int y = 40;
+  int sum = 0;
+  sqrl::Thread t1(std::allocator_arg, CountingAllocator<char>(&count), add,
+                  &x, &y, &sum);
+  t1.join();
+  EXPECT_EQ(sum, 70);
+  // function pack goes back to the allocator it comes from
+  EXPECT_EQ(count, 0);
+}
@@ -1,3 +1,5 @@
+#include <atomic>
+#include <functional>
 #include <gtest/gtest.h>
 #include <thread/threadpool.h>
 
@@ -47,6 +49,18 @@ TEST_P(ThreadPoolTest, add_tasks_more_than_pool_size) {
   ASSERT_EQ(tp.get_handled_tasks_num(), tasks_num);
 }
 
+TEST_P(ThreadPoolTest, burst_of_tasks_before_start) {
+  auto func = []() {};
+  ThreadPool tp;
+  int tasks_num = 1000;
+  for (int i = 0; i < tasks_num; i++) {
+    tp.enqueue(func);
+  }
+  tp.start();
+  tp.stop();
+  ASSERT_EQ(tp.get_handled_tasks_num(), tasks_num);
+}
+
 TEST_P(ThreadPoolTest, add_task_with_parameters) {
   bool flag = false;
   auto func = [&flag](int a) -> int {
@@ -63,5 +77,85 @@ TEST_P(ThreadPoolTest, add_task_with_parameters) {
   ASSERT_EQ(result.get(), 2);
 }
 
+TEST_P(ThreadPoolTest, enqueue_from_task) {
+  ThreadPool tp(GetParam() % 4 + 1);
+  std::atomic<int> count(0);
+  tp.start();
+  for (int i = 0; i < 10; i++) {
+    tp.enqueue([&tp, &count]() {
+      for (int j = 0; j < 10; j++) {
+        tp.enqueue([&count]() { count++; });
+      }
+    });
+  }
+  tp.stop();
+  ASSERT_EQ(count, 100);
+  ASSERT_EQ(tp.get_handled_tasks_num(), 110);
+}
+
+static int fib(ThreadPool &tp, int n) {
+  if (n < 2) {
+    return n;
+  }
+  auto left = tp.enqueue(fib, std::ref(tp), n - 1);
+  int right = fib(tp, n - 2);
+  return tp.await(left) + right;
+}
+
+TEST_P(ThreadPoolTest, await_fork_join) {
+  ThreadPool tp(GetParam() % 4 + 1);
+  tp.start();
+  auto result = tp.enqueue(fib, std::ref(tp), 15);
+  ASSERT_EQ(tp.await(result), 610);
+  tp.stop();
+}
+
+TEST_P(ThreadPoolTest, destroy_without_stop) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool tp;
+    tp.start();
+    for (int i = 0; i < 100; i++) {
+      tp.enqueue([&count]() { count++; });
+    }
+  }
+  ASSERT_EQ(count, 100);
+  {
+    // never started, tasks are dropped
+    ThreadPool tp;
+    for (int i = 0; i < 100; i++) {
+      tp.enqueue([&count]() { count++; });
+    }
+  }
+  ASSERT_EQ(count, 100);
+}
+
+TEST_P(ThreadPoolTest, stop_without_start) {
+  ThreadPool tp(2);
+  tp.stop();
+  ASSERT_EQ(tp.get_handled_tasks_num(), 0);
+}
+
+TEST_P(ThreadPoolTest, pool_size_at_least_one) {
+  for (int size : {0, -1}) {
+    ThreadPool tp(size);
+    ASSERT_EQ(tp.get_pool_size(), 1);
+    tp.start();
+    auto future = tp.enqueue([]() { return 3; });
+    ASSERT_EQ(tp.await(future), 3);
+    tp.stop();
+    ASSERT_EQ(tp.get_handled_tasks_num(), 1);
+  }
+}
+
+TEST_P(ThreadPoolTest, stop_twice) {
+  ThreadPool tp(2);
+  tp.start();
+  tp.enqueue([]() {});
+  tp.stop();
+  tp.stop();
+  ASSERT_EQ(tp.get_handled_tasks_num(), 1);
+}
+
 INSTANTIATE_TEST_SUITE_P(test_threadpool, ThreadPoolTest,
                          ::testing::Range(1, MAX_LOOP_NUM));
\ No newline at end of file
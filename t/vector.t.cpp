@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 #include <memory/_allocator_impl.h>
 #include <metaprogramming/types.h>
+#include <string/string.h>
 
 using namespace sqrl;
 
@@ -27,6 +28,8 @@ struct NoMove {
 struct NoCopy {
   NoCopy(int x) : data(new int(x)){};
   NoCopy(const NoCopy &) = delete;
+  // vector relocates elements by it when it grows
+  NoCopy(NoCopy &&other) : data(other.data) { other.data = nullptr; }
   // only resize & push_back require = operator
   NoCopy &operator=(const NoCopy &other) {
     if (this != &other) {
@@ -71,8 +74,8 @@ TEST_F(SafeVectorTest, initialize_by_initializer_list) {
   EXPECT_EQ(v[2], 3);
   EXPECT_EQ(v.size(), 3);
 
-  EXPECT_EQ(viewer.memory_size(),
-            alloc_size(sizeof(int) * SQRL_VECTOR_DEFAULT_INIT_SIZE));
+  // space of the list size is allocated once
+  EXPECT_EQ(viewer.memory_size(), alloc_size(sizeof(int) * 3));
 }
 
 TEST_F(SafeVectorTest, vector_iterator) {
@@ -82,7 +85,7 @@ TEST_F(SafeVectorTest, vector_iterator) {
     EXPECT_EQ(*itr, element++);
   }
   EXPECT_EQ(viewer.memory_size(),
-            alloc_size(sizeof(int) * SQRL_VECTOR_DEFAULT_INIT_SIZE));
+            alloc_size(sizeof(int) * 3));
 }
 
 TEST_F(SafeVectorTest, initialize_by_shallow_copy) {
@@ -93,7 +96,7 @@ TEST_F(SafeVectorTest, initialize_by_shallow_copy) {
     EXPECT_EQ(*itr, element++);
   }
   EXPECT_EQ(viewer.memory_size(),
-            alloc_size(sizeof(int) * SQRL_VECTOR_DEFAULT_INIT_SIZE) * 2);
+            alloc_size(sizeof(int) * 3) * 2);
 }
 
 TEST_F(SafeVectorTest, pop_back) {
@@ -106,7 +109,7 @@ TEST_F(SafeVectorTest, pop_back) {
   EXPECT_EQ(v[1], 2);
   EXPECT_EQ(v[2], 100);
   EXPECT_EQ(viewer.memory_size(),
-            alloc_size(sizeof(int) * SQRL_VECTOR_DEFAULT_INIT_SIZE));
+            alloc_size(sizeof(int) * 3));
 }
 
 TEST_F(SafeVectorTest, initialize_by_iterator) {
@@ -117,7 +120,7 @@ TEST_F(SafeVectorTest, initialize_by_iterator) {
     EXPECT_EQ(*itr, element++);
   }
   EXPECT_EQ(viewer.memory_size(),
-            alloc_size(sizeof(int) * SQRL_VECTOR_DEFAULT_INIT_SIZE) * 2);
+            alloc_size(sizeof(int) * 3) * 2);
 }
 
 TEST_F(SafeVectorTest, pointer_element) {
@@ -227,4 +230,400 @@ TEST_F(SafeVectorTest, resize_when_exceed_capacity) {
     EXPECT_EQ(viewer.memory_size(), alloc_size(sizeof(int) * vector_size));
   }
   EXPECT_EQ(viewer.memory_size(), 0);
-}
\ No newline at end of file
+}
+// allocator sharing a counter between copies, it never propagates on move
+template <typename T> struct CountingAllocator {
+  using value_type = T;
+  int *count;
+  sqrl::Allocator<T> impl;
+  CountingAllocator(int *count) : count(count) {}
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U> &other) : count(other.count) {}
+  T *allocate(size_t size) {
+    (*count)++;
+    return impl.allocate(size);
+  }
+  void deallocate(T *t, size_t size) {
+    (*count)--;
+    impl.deallocate(t, size);
+  }
+};
+
+// allocator counting elements moved by reallocate
+template <typename T> struct ReallocatingAllocator {
+  using value_type = T;
+  int *count;
+  sqrl::Allocator<T> impl;
+  ReallocatingAllocator(int *count) : count(count) {}
+  T *allocate(size_t size) { return impl.allocate(size); }
+  T *reallocate(T *t, size_t size, size_t new_size) {
+    (*count)++;
+    return impl.reallocate(t, size, new_size);
+  }
+  void deallocate(T *t, size_t size) { impl.deallocate(t, size); }
+};
+
+TEST_F(SafeVectorTest, grow_by_reallocate) {
+  int count = 0;
+  {
+    Vector<int, ReallocatingAllocator<int>> v{
+        ReallocatingAllocator<int>(&count)};
+    for (int i = 0; i < 1000; i++) {
+      v.push_back(i);
+    }
+    EXPECT_GT(count, 0);
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_EQ(v[i], i);
+    }
+  }
+  static_assert(AllocatorTraits<ReallocatingAllocator<int>>::can_reallocate);
+  static_assert(!AllocatorTraits<CountingAllocator<int>>::can_reallocate);
+}
+
+TEST_F(SafeVectorTest, construct_with_allocator) {
+  int count = 0;
+  {
+    CountingAllocator<int> alloc(&count);
+    Vector<int, CountingAllocator<int>> v(alloc);
+    Vector<int, CountingAllocator<int>> v2({1, 2, 3}, alloc);
+    EXPECT_EQ(count, 2);
+    // copy shares the allocator state
+    Vector<int, CountingAllocator<int>> copy(v2);
+    EXPECT_EQ(count, 3);
+    EXPECT_EQ(copy.get_allocator().count, &count);
+  }
+  EXPECT_EQ(count, 0);
+}
+
+TEST_F(SafeVectorTest, move_takes_memory) {
+  Vector<int> v({1, 2, 3});
+  int *data = v.begin();
+  size_t used = viewer.memory_size();
+  Vector<int> moved(std::move(v));
+  EXPECT_EQ(moved.begin(), data);
+  EXPECT_EQ(moved.size(), 3);
+  EXPECT_EQ(v.size(), 0);
+  // the moved one has no space left
+  EXPECT_EQ(v.capacity(), 0);
+  EXPECT_EQ(viewer.memory_size(), used);
+  Vector<int> assigned;
+  assigned = std::move(moved);
+  EXPECT_EQ(assigned.begin(), data);
+  EXPECT_EQ(assigned[2], 3);
+  EXPECT_EQ(moved.capacity(), 0);
+  // a moved one allocates again once an element comes
+  v.push_back(4);
+  moved.resize(2, 5);
+  EXPECT_EQ(v[0], 4);
+  EXPECT_EQ(moved[1], 5);
+}
+
+TEST_F(SafeVectorTest, move_without_propagation) {
+  int count = 0;
+  int other_count = 0;
+  {
+    Vector<int, CountingAllocator<int>> v({1, 2, 3},
+                                          CountingAllocator<int>(&count));
+    Vector<int, CountingAllocator<int>> target(
+        (CountingAllocator<int>(&other_count)));
+    target = std::move(v);
+    // elements are moved into memory of target allocator
+    EXPECT_EQ(target.get_allocator().count, &other_count);
+    EXPECT_EQ(target.size(), 3);
+    EXPECT_EQ(target[2], 3);
+    EXPECT_EQ(v.size(), 0);
+    EXPECT_EQ(count, 1);
+    EXPECT_EQ(other_count, 1);
+  }
+  EXPECT_EQ(count, 0);
+  EXPECT_EQ(other_count, 0);
+}
+
+// counts how elements are relocated
+static int moves = 0;
+static int copies = 0;
+template <bool Noexcept> struct Relocated {
+  Relocated(int x) : value(x) {}
+  Relocated(const Relocated &other) : value(other.value) { copies++; }
+  Relocated(Relocated &&other) noexcept(Noexcept) : value(other.value) {
+    moves++;
+  }
+  ~Relocated() {}
+  int value;
+};
+
+TEST(test_vector, relocate_by_move_if_noexcept) {
+  moves = copies = 0;
+  {
+    Vector<Relocated<true>> v;
+    for (int i = 0; i < 100; i++) {
+      v.emplace_back(i);
+    }
+    EXPECT_EQ(copies, 0);
+    EXPECT_EQ(moves, SQRL_VECTOR_DEFAULT_INIT_SIZE);
+  }
+  moves = copies = 0;
+  {
+    // a throwing move may leave both spaces broken, copy instead
+    Vector<Relocated<false>> v;
+    for (int i = 0; i < 100; i++) {
+      v.emplace_back(i);
+    }
+    EXPECT_EQ(moves, 0);
+    EXPECT_EQ(copies, SQRL_VECTOR_DEFAULT_INIT_SIZE);
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(v[i].value, i);
+    }
+  }
+}
+
+TEST(test_vector, grow_by_growth_factor) {
+  Vector<int, Allocator<int>, GrowthFactor<3, 2>> v;
+  for (int i = 0; i < SQRL_VECTOR_DEFAULT_INIT_SIZE + 1; i++) {
+    v.push_back(i);
+  }
+  EXPECT_EQ(v.capacity(), SQRL_VECTOR_DEFAULT_INIT_SIZE * 3 / 2);
+  EXPECT_EQ(GrowthFactor<2>::grow(0, 1), 1);
+}
+
+TEST_F(SafeVectorTest, reserve_and_shrink_to_fit) {
+  Vector<NoMove> v;
+  v.reserve(1000);
+  EXPECT_EQ(v.capacity(), 1000);
+  for (int i = 0; i < 1000; i++) {
+    v.emplace_back(i);
+  }
+  EXPECT_EQ(v.capacity(), 1000);
+  // reserve never shrinks
+  v.reserve(10);
+  EXPECT_EQ(v.capacity(), 1000);
+  for (int i = 0; i < 900; i++) {
+    v.pop_back();
+  }
+  v.shrink_to_fit();
+  EXPECT_EQ(v.capacity(), 100);
+  EXPECT_EQ(viewer.memory_size(), alloc_size(sizeof(NoMove) * 100));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(*v[i].data, i);
+  }
+  EXPECT_EQ(reference_count, 100);
+}
+
+TEST(test_vector, relocate_strings) {
+  static_assert(is_trivially_relocatable_v<String>);
+  static_assert(!is_trivially_relocatable_v<NoMove>);
+  Vector<String> v;
+  for (int i = 0; i < 1000; i++) {
+    v.push_back(String("squirrel"));
+  }
+  // the element pushed may live in the space being relocated
+  while (v.size() != v.capacity()) {
+    v.push_back(String("squirrel"));
+  }
+  size_t full = v.size();
+  v.push_back(v[0]);
+  EXPECT_EQ(v.size(), full + 1);
+  for (size_t i = 0; i < v.size(); i++) {
+    ASSERT_TRUE(v[i] == String("squirrel"));
+  }
+}
+
+TEST_F(SafeVectorTest, small_vector_stays_inline) {
+  SmallVector<NoMove, 8> v;
+  for (int i = 0; i < 8; i++) {
+    v.emplace_back(i);
+  }
+  EXPECT_TRUE(v.is_inline());
+  EXPECT_EQ(v.capacity(), 8);
+  EXPECT_EQ(viewer.memory_size(), 0);
+  int i = 0;
+  for (auto itr = v.begin(); itr != v.end(); itr++) {
+    EXPECT_EQ(*itr->data, i++);
+  }
+}
+
+TEST_F(SafeVectorTest, small_vector_spills_and_comes_back) {
+  {
+    SmallVector<NoMove, 4> v;
+    for (int i = 0; i < 100; i++) {
+      v.emplace_back(i);
+    }
+    EXPECT_FALSE(v.is_inline());
+    EXPECT_GT(viewer.memory_size(), 0);
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(*v[i].data, i);
+    }
+    while (v.size() > 3) {
+      v.pop_back();
+    }
+    v.shrink_to_fit();
+    EXPECT_TRUE(v.is_inline());
+    EXPECT_EQ(viewer.memory_size(), 0);
+    EXPECT_EQ(*v[2].data, 2);
+    EXPECT_EQ(reference_count, 3);
+  }
+  EXPECT_EQ(reference_count, 0);
+}
+
+TEST_F(SafeVectorTest, copy_assign) {
+  Vector<int> v = {1, 2, 3};
+  Vector<int> v2 = {4};
+  v2 = v;
+  EXPECT_EQ(v2.size(), 3);
+  EXPECT_EQ(v2[2], 3);
+  v2 = v2;
+  EXPECT_EQ(v2.size(), 3);
+
+  SmallVector<int, 4> small = {1, 2};
+  SmallVector<int, 4> large;
+  for (int i = 0; i < 100; i++) {
+    large.push_back(i);
+  }
+  small = large;
+  EXPECT_FALSE(small.is_inline());
+  EXPECT_EQ(small.size(), 100);
+  EXPECT_EQ(small[99], 99);
+  large = SmallVector<int, 4>{5, 6};
+  small = large;
+  EXPECT_EQ(small.size(), 2);
+  EXPECT_EQ(small[1], 6);
+}
+
+TEST_F(SafeVectorTest, small_vector_move) {
+  SmallVector<int, 4> small = {1, 2, 3};
+  SmallVector<int, 4> moved(std::move(small));
+  EXPECT_TRUE(moved.is_inline());
+  EXPECT_EQ(moved.size(), 3);
+  EXPECT_EQ(moved[2], 3);
+  EXPECT_EQ(small.size(), 0);
+
+  SmallVector<int, 4> large;
+  for (int i = 0; i < 100; i++) {
+    large.push_back(i);
+  }
+  int *data = large.begin();
+  SmallVector<int, 4> taken(std::move(large));
+  // memory from allocator moves as a whole
+  EXPECT_EQ(taken.begin(), data);
+  EXPECT_TRUE(large.is_inline());
+  large = std::move(moved);
+  EXPECT_EQ(large.size(), 3);
+  EXPECT_EQ(large[0], 1);
+  // a Vector takes inline elements one by one
+  Vector<int> vector(std::move(large));
+  EXPECT_EQ(vector.size(), 3);
+  EXPECT_EQ(vector[1], 2);
+  EXPECT_EQ(large.size(), 0);
+}
+
+TEST_F(SafeVectorTest, construct_with_exact_size) {
+  int data[1000];
+  for (int i = 0; i < 1000; i++) {
+    data[i] = i;
+  }
+  Vector<int> v(data, data + 1000);
+  EXPECT_EQ(v.capacity(), 1000);
+  EXPECT_EQ(v[999], 999);
+  Vector<NoMove> filled(100, NoMove(7));
+  EXPECT_EQ(filled.capacity(), 100);
+  EXPECT_EQ(reference_count, 100);
+  EXPECT_EQ(*filled[99].data, 7);
+  EXPECT_EQ(viewer.memory_size(),
+            alloc_size(sizeof(int) * 1000) + alloc_size(sizeof(NoMove) * 100));
+}
+
+TEST_F(SafeVectorTest, assign_range) {
+  {
+    Vector<NoMove> v;
+    for (int i = 0; i < 10; i++) {
+      v.emplace_back(i);
+    }
+    NoMove items[3] = {NoMove(1), NoMove(2), NoMove(3)};
+    v.assign(items, items + 3);
+    EXPECT_EQ(v.size(), 3);
+    // space large enough is kept
+    EXPECT_EQ(v.capacity(), SQRL_VECTOR_DEFAULT_INIT_SIZE);
+    EXPECT_EQ(*v[2].data, 3);
+    EXPECT_EQ(reference_count, 6);
+    v.assign(200, v[0]);
+    EXPECT_EQ(v.size(), 200);
+    EXPECT_EQ(v.capacity(), 200);
+    EXPECT_EQ(*v[199].data, 1);
+    EXPECT_EQ(reference_count, 203);
+  }
+  Vector<int> ints = {1, 2};
+  ints.assign({4, 5, 6});
+  EXPECT_EQ(ints.size(), 3);
+  EXPECT_EQ(ints[0], 4);
+  EXPECT_EQ(ints[2], 6);
+}
+
+TEST_F(SafeVectorTest, insert_range) {
+  {
+    Vector<NoMove> v;
+    for (int i = 0; i < 40; i++) {
+      v.emplace_back(i);
+    }
+    Vector<NoMove> items;
+    for (int i = 100; i < 120; i++) {
+      items.emplace_back(i);
+    }
+    // relocated around the range into a larger space
+    NoMove *pos = v.insert(v.begin() + 10, items.begin(), items.end());
+    EXPECT_EQ(pos, v.begin() + 10);
+    EXPECT_EQ(v.size(), 60);
+    // room is enough, moved aside in place
+    v.insert(v.begin(), items.begin(), items.begin() + 5);
+    EXPECT_EQ(v.size(), 65);
+    EXPECT_EQ(reference_count, 85);
+    for (int i = 0; i < 5; i++) {
+      ASSERT_EQ(*v[i].data, 100 + i);
+    }
+    for (int i = 0; i < 10; i++) {
+      ASSERT_EQ(*v[5 + i].data, i);
+    }
+    for (int i = 0; i < 20; i++) {
+      ASSERT_EQ(*v[15 + i].data, 100 + i);
+    }
+    for (int i = 10; i < 40; i++) {
+      ASSERT_EQ(*v[25 + i].data, i);
+    }
+  }
+  Vector<int, Allocator<int>, GrowthFactor<3, 2>> ints = {1, 2, 3};
+  int data[] = {10, 11, 12, 13};
+  ints.insert(ints.begin() + 1, data, data + 4);
+  EXPECT_EQ(ints.capacity(), 7);
+  int expected[] = {1, 10, 11, 12, 13, 2, 3};
+  for (int i = 0; i < 7; i++) {
+    ASSERT_EQ(ints[i], expected[i]);
+  }
+}
+
+TEST_F(SafeVectorTest, append_range) {
+  Vector<String> v;
+  const char *input[] = {"a", "string too long for inline buffer", "c"};
+  for (int round = 0; round < 30; round++) {
+    v.append_range(input);
+  }
+  EXPECT_EQ(v.size(), 90);
+  EXPECT_STREQ(v[88].c_str(), "string too long for inline buffer");
+  EXPECT_STREQ(v[89].c_str(), "c");
+}
+
+TEST_F(SafeVectorTest, resize_with_value) {
+  Vector<int> v = {1, 2, 3};
+  v.resize(100);
+  EXPECT_EQ(v.size(), 100);
+  EXPECT_EQ(v[2], 3);
+  EXPECT_EQ(v[99], 0);
+  v.resize(2);
+  EXPECT_EQ(v.size(), 2);
+  {
+    Vector<NoMove> objects;
+    objects.resize(10, NoMove(5));
+    EXPECT_EQ(reference_count, 10);
+    objects.resize(4, NoMove(6));
+    EXPECT_EQ(reference_count, 4);
+    EXPECT_EQ(*objects[3].data, 5);
+  }
+}
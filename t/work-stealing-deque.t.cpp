@@ -0,0 +1,103 @@
+#include <atomic>
+#include <container/work_stealing_deque.h>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace sqrl;
+
+TEST(work_stealing_deque_test, owner_last_in_first_out) {
+  WorkStealingDeque<int> d(4);
+  int out;
+  EXPECT_TRUE(d.empty());
+  EXPECT_FALSE(d.pop(out));
+  for (int i = 0; i < 3; i++) {
+    d.push(i);
+  }
+  EXPECT_EQ(d.size(), 3);
+  for (int i = 2; i >= 0; i--) {
+    ASSERT_TRUE(d.pop(out));
+    ASSERT_EQ(out, i);
+  }
+  EXPECT_FALSE(d.pop(out));
+  EXPECT_TRUE(d.empty());
+}
+
+TEST(work_stealing_deque_test, steal_first_in_first_out) {
+  WorkStealingDeque<int> d(4);
+  int out;
+  EXPECT_FALSE(d.steal(out));
+  for (int i = 0; i < 3; i++) {
+    d.push(i);
+  }
+  ASSERT_TRUE(d.steal(out));
+  EXPECT_EQ(out, 0);
+  ASSERT_TRUE(d.pop(out));
+  EXPECT_EQ(out, 2);
+  ASSERT_TRUE(d.steal(out));
+  EXPECT_EQ(out, 1);
+  EXPECT_FALSE(d.steal(out));
+  EXPECT_FALSE(d.pop(out));
+}
+
+TEST(work_stealing_deque_test, grow) {
+  WorkStealingDeque<int> d(2);
+  int out;
+  // top moves on so the ring wraps before growing
+  for (int i = 0; i < 3; i++) {
+    d.push(-1);
+    ASSERT_TRUE(d.steal(out));
+  }
+  for (int i = 0; i < 100; i++) {
+    d.push(i);
+  }
+  EXPECT_EQ(d.size(), 100);
+  for (int i = 0; i < 50; i++) {
+    ASSERT_TRUE(d.steal(out));
+    ASSERT_EQ(out, i);
+  }
+  for (int i = 99; i >= 50; i--) {
+    ASSERT_TRUE(d.pop(out));
+    ASSERT_EQ(out, i);
+  }
+  EXPECT_TRUE(d.empty());
+}
+
+TEST(work_stealing_deque_test, owner_and_stealers) {
+  const int stealers = 3;
+  const int items = 20000;
+  WorkStealingDeque<int> d(8);
+  std::vector<std::atomic<int>> taken(items);
+  std::atomic<bool> done(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < stealers; t++) {
+    threads.emplace_back([&]() {
+      int out;
+      while (!done || !d.empty()) {
+        if (d.steal(out)) {
+          taken[out]++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  int out;
+  for (int i = 0; i < items; i++) {
+    d.push(i);
+    // owner takes some back meanwhile
+    if (i % 3 == 0 && d.pop(out)) {
+      taken[out]++;
+    }
+  }
+  while (d.pop(out)) {
+    taken[out]++;
+  }
+  done = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < items; i++) {
+    ASSERT_EQ(taken[i], 1) << i;
+  }
+}